@@ -0,0 +1,93 @@
+#
+# Copyright (C) 2016 Sebastian Schmidt
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+cmake_policy(PUSH)
+# DEPFILE paths are rewritten relative to the build directory for Ninja
+if(POLICY CMP0116)
+    cmake_policy(SET CMP0116 NEW)
+endif()
+
+# Schema files included by a schema, directly or indirectly, for generators without depfile support
+function(_settingswidget_schema_includes output schema)
+    set(files ${schema})
+    set(pending ${schema})
+    while(pending)
+        list(GET pending 0 file)
+        list(REMOVE_AT pending 0)
+        if(EXISTS ${file})
+            file(READ ${file} content)
+            get_filename_component(directory ${file} PATH)
+            string(REGEX MATCHALL "\"\\$include\"[ \t\r\n]*:[ \t\r\n]*\"[^\"]+\"" includes "${content}")
+            foreach(include ${includes})
+                string(REGEX REPLACE ".*\"([^\"]+)\"$" "\\1" name "${include}")
+                if(IS_ABSOLUTE ${name})
+                    set(path ${name})
+                else()
+                    set(path ${directory}/${name})
+                endif()
+                list(FIND files ${path} index)
+                if(index EQUAL -1)
+                    list(APPEND files ${path})
+                    list(APPEND pending ${path})
+                endif()
+            endforeach()
+        endif()
+    endwhile()
+    set(${output} ${files} PARENT_SCOPE)
+endfunction()
+
+# settingswidget_generate_accessors(<output variable> <schema.json> <namespace>)
+#
+# Generates <schema name>_settings.h in the current binary directory from a json schema. The header
+# contains the schema as a static QJsonArray and typed key structs for settingsaccessors.h.
+# The paths of the generated header and its stamp file are stored in the output variable, add them to
+# the sources of the target. Files included by the schema are dependencies of the header as well.
+function(settingswidget_generate_accessors output schema namespace)
+    get_filename_component(schema_path ${schema} ABSOLUTE)
+    get_filename_component(schema_name ${schema} NAME_WE)
+    set(header ${CMAKE_CURRENT_BINARY_DIR}/${schema_name}_settings.h)
+    # the generator keeps an unchanged header untouched, the stamp records that it is up to date
+    set(stamp ${CMAKE_CURRENT_BINARY_DIR}/${schema_name}_settings.stamp)
+    if(NOT CMAKE_VERSION VERSION_LESS 3.20 AND CMAKE_GENERATOR MATCHES "Ninja|Makefiles")
+        # the generator lists the included files it resolved
+        set(depfile ${CMAKE_CURRENT_BINARY_DIR}/${schema_name}_settings.d)
+        add_custom_command(
+            OUTPUT ${stamp}
+            BYPRODUCTS ${header}
+            COMMAND settingswidget_codegen ${schema_path} ${header} ${namespace} ${depfile} ${stamp}
+            COMMAND ${CMAKE_COMMAND} -E touch ${stamp}
+            DEPENDS settingswidget_codegen ${schema_path}
+            DEPFILE ${depfile}
+            COMMENT "Generating settings accessors from ${schema}"
+        )
+    else()
+        # includes added later are picked up when cmake runs again
+        _settingswidget_schema_includes(schema_files ${schema_path})
+        set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${schema_files})
+        add_custom_command(
+            OUTPUT ${stamp}
+            BYPRODUCTS ${header}
+            COMMAND settingswidget_codegen ${schema_path} ${header} ${namespace}
+            COMMAND ${CMAKE_COMMAND} -E touch ${stamp}
+            DEPENDS settingswidget_codegen ${schema_files}
+            COMMENT "Generating settings accessors from ${schema}"
+        )
+    endif()
+    set(${output} ${header} ${stamp} PARENT_SCOPE)
+endfunction()
+
+cmake_policy(POP)
@@ -0,0 +1,96 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SETTINGCONDITION_H
+#define SETTINGCONDITION_H
+
+#include <functional>
+#include <memory>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+
+
+/**
+ * @brief A parsed "visible_if"/"enabled_if" expression
+ *
+ * Expressions reference other settings by "section/key" and support comparisons with
+ * literals, negation, "&&", "||" and parentheses, e.g.
+ * "logging/enabled && logging/level != 'off'".
+ * A reference on its own is true when the setting is set to a true, non-zero or non-empty value.
+ */
+class SettingCondition
+{
+public:
+
+    /**
+     * @brief Returns the current value of a referenced setting ("section/key")
+     */
+    typedef std::function<QVariant(const QString&)> Resolver;
+
+    /**
+     * @brief Creates an empty condition which always evaluates to true
+     */
+    SettingCondition();
+
+    /**
+     * @brief Parse a condition expression
+     *
+     * @param expression the expression
+     * @param ok set to false if the expression could not be parsed
+     * @return SettingCondition the parsed condition or an empty condition on error
+     */
+    static SettingCondition parse(const QString& expression, bool* ok = 0);
+
+    /**
+     * @brief Whether this is an empty condition
+     *
+     * @return bool
+     */
+    bool isNull() const;
+
+    /**
+     * @brief All settings ("section/key") the condition depends on
+     *
+     * @return QStringList
+     */
+    QStringList references() const;
+
+    /**
+     * @brief Evaluate the condition
+     *
+     * @param resolver function that provides the values of the referenced settings
+     * @return bool
+     */
+    bool evaluate(const Resolver& resolver) const;
+
+    /**
+     * @brief Node of the parsed expression tree (implementation detail)
+     */
+    struct Node;
+
+private:
+
+    std::shared_ptr<const Node> _root;
+
+    QStringList _references;
+};
+
+#endif // SETTINGCONDITION_H
@@ -21,8 +21,13 @@
 #ifndef SETTINGITEMS_H
 #define SETTINGITEMS_H
 
+#include <memory>
 #include <QtWidgets>
 #include <QJsonObject>
+#include <QFutureWatcher>
+
+#include "settingsstore.h"
+#include "settingvalidator.h"
 
 
 /**
@@ -59,6 +64,72 @@ public:
      */
     virtual void saveSetting() = 0;
 
+    /**
+     * @brief The current (possibly unsaved) value of the setting
+     *
+     * @return QVariant
+     */
+    virtual QVariant value() const;
+
+    /**
+     * @brief The default value of the setting
+     *
+     * @return QVariant
+     */
+    virtual QVariant defaultValue() const;
+
+    /**
+     * @brief Whether the current value equals the default value
+     *
+     * @return bool
+     */
+    virtual bool isDefault() const;
+
+    /**
+     * @brief Change the current value without saving it
+     *
+     * @param value the new value, already converted to the setting's type
+     * @return void
+     */
+    virtual void setValue(const QVariant& value);
+
+    /**
+     * @brief Reload the setting from the storage, discarding unsaved changes
+     *
+     * @return void
+     */
+    void reload();
+
+    /**
+     * @brief The section where the setting is saved
+     *
+     * @return QString
+     */
+    QString section() const;
+
+    /**
+     * @brief The key which is used to save the setting
+     *
+     * @return QString
+     */
+    QString key() const;
+
+    /**
+     * @brief The description from the json description or, if there is none, from a help file
+     *
+     * It is looked up in SettingsHelp by the full key each time.
+     *
+     * @return QString
+     */
+    QString description() const;
+
+signals:
+
+    /**
+     * @brief Emitted whenever the user changes the value
+     */
+    void valueChanged();
+
 protected:
 
     /**
@@ -68,6 +139,34 @@ protected:
      */
     virtual void loadSetting() = 0;
 
+    /**
+     * @brief Builds the tooltip from the description and the source layer when it is requested
+     */
+    bool event(QEvent* event);
+
+    /**
+     * @brief Read the stored value of this setting, taking all layers of an attached SettingsStore into account
+     *
+     * @param default_value the value to use if the setting is not stored
+     * @return QVariant
+     */
+    QVariant readValue(const QVariant& default_value);
+
+    /**
+     * @brief Write the value of this setting
+     *
+     * @param value the new value
+     * @return void
+     */
+    void writeValue(const QVariant& value);
+
+    /**
+     * @brief Remember the layer the current value comes from if a SettingsStore is attached
+     *
+     * @return void
+     */
+    void updateSource();
+
     /**
      * @brief Pointer to the settings instance
      */
@@ -98,6 +197,15 @@ public:
 
     static SettingItem* fromJsonObject(QJsonObject obj, QSettings* settings, QWidget* parent = 0);
 
+    /**
+     * @brief Check a value against the json description and convert it to the setting's type
+     *
+     * @param obj the json object describing the setting
+     * @param value the value to check, converted in place
+     * @return bool false if the value is not valid for the setting
+     */
+    static bool convertValue(const QJsonObject& obj, QVariant& value);
+
     /**
      * @brief Restore the default value
      *
@@ -112,6 +220,12 @@ public:
      */
     void saveSetting();
 
+    QVariant value() const;
+
+    QVariant defaultValue() const;
+
+    void setValue(const QVariant& value);
+
 protected:
 
     /**
@@ -139,9 +253,19 @@ class SettingString : public SettingItem
 
 public:
     SettingString(QSettings* settings, QString title, QString section, QString key, QString default_value, QString desc = "", QWidget* parent = 0);
+    ~SettingString();
 
     static SettingItem* fromJsonObject(QJsonObject obj, QSettings* settings, QWidget* parent = 0);
 
+    /**
+     * @brief Check a value against the json description and convert it to the setting's type
+     *
+     * @param obj the json object describing the setting
+     * @param value the value to check, converted in place
+     * @return bool false if the value is not valid for the setting
+     */
+    static bool convertValue(const QJsonObject& obj, QVariant& value);
+
     /**
      * @brief Restore the default value
      *
@@ -156,6 +280,27 @@ public:
      */
     void saveSetting();
 
+    QVariant value() const;
+
+    QVariant defaultValue() const;
+
+    void setValue(const QVariant& value);
+
+    /**
+     * @brief Validate the text while the user types. Invalid values are not saved.
+     *
+     * @param validator the constraints for the text
+     * @return void
+     */
+    void setValidator(SettingValidator validator);
+
+    /**
+     * @brief Whether the current text passed the validation. Pending asynchronous checks count as valid.
+     *
+     * @return bool
+     */
+    bool isValid() const;
+
 protected:
 
     /**
@@ -170,6 +315,33 @@ private:
     QLineEdit* _line_edit;
 
     QString _default_value;
+
+    SettingValidator _validator;
+
+    /**
+     * @brief Error message of the last validation, empty if the text is valid
+     */
+    QString _error;
+
+    /**
+     * @brief Delays asynchronous validation until the user stops typing
+     */
+    QTimer* _async_timer = nullptr;
+
+    QFutureWatcher<QString>* _async_watcher = nullptr;
+
+    /**
+     * @brief Cancellation flag of the running asynchronous validation
+     */
+    std::shared_ptr<std::atomic<bool>> _async_cancelled;
+
+    void validate();
+
+    void startAsyncValidation();
+
+    void finishAsyncValidation();
+
+    void showValidity();
 };
 
 
@@ -189,6 +361,15 @@ public:
 
     static SettingItem* fromJsonObject(QJsonObject obj, QSettings* settings, QWidget* parent = 0);
 
+    /**
+     * @brief Check a value against the json description and convert it to the setting's type
+     *
+     * @param obj the json object describing the setting
+     * @param value the value to check, converted in place
+     * @return bool false if the value is not valid for the setting
+     */
+    static bool convertValue(const QJsonObject& obj, QVariant& value);
+
     /**
      * @brief Restore the default value
      *
@@ -203,6 +384,12 @@ public:
      */
     void saveSetting();
 
+    QVariant value() const;
+
+    QVariant defaultValue() const;
+
+    void setValue(const QVariant& value);
+
 protected:
 
     /**
@@ -242,6 +429,15 @@ public:
 
     static SettingItem* fromJsonObject(QJsonObject obj, QSettings* settings, QWidget* parent = 0);
 
+    /**
+     * @brief Check a value against the json description and convert it to the setting's type
+     *
+     * @param obj the json object describing the setting
+     * @param value the value to check, converted in place
+     * @return bool false if the value is not valid for the setting
+     */
+    static bool convertValue(const QJsonObject& obj, QVariant& value);
+
     /**
      * @brief Restore the default value
      *
@@ -256,6 +452,14 @@ public:
      */
     void saveSetting();
 
+    QVariant value() const;
+
+    QVariant defaultValue() const;
+
+    bool isDefault() const;
+
+    void setValue(const QVariant& value);
+
 protected:
 
     /**
@@ -281,11 +485,51 @@ class SettingOptions : public SettingItem
     Q_OBJECT
 
 public:
+
+    /**
+     * @brief Function that enumerates the options of a setting, called on a worker thread
+     *
+     * Receives the "provider_args" of the json description and returns the options by label.
+     */
+    typedef std::function<QVariantMap(const QJsonObject&)> OptionProvider;
+
     SettingOptions(QSettings* settings, QString title, QString section, QString key, QVariant default_value,
                    QVariantMap options, QString desc = "", QWidget* parent = 0);
 
+    /**
+     * @brief Create a SettingOptions whose options are loaded from a provider when the combobox is opened
+     *
+     * The stored value is shown until the options are loaded.
+     *
+     * @param provider the name of a registered provider
+     * @param provider_args arguments passed to the provider
+     */
+    SettingOptions(QSettings* settings, QString title, QString section, QString key, QVariant default_value,
+                   QString provider, QJsonObject provider_args, QString desc = "", QWidget* parent = 0);
+
+    /**
+     * @brief Register an option provider that can be referenced with the "provider" field
+     *
+     * The options are cached for all SettingOptions using the provider with the same arguments.
+     *
+     * @param name the name used in the json description
+     * @param provider the function enumerating the options
+     * @param ttl time in milliseconds after which the cached options are loaded again
+     * @return void
+     */
+    static void registerProvider(QString name, OptionProvider provider, int ttl = 60000);
+
     static SettingItem* fromJsonObject(QJsonObject obj, QSettings* settings, QWidget* parent = 0);
 
+    /**
+     * @brief Check a value against the json description and convert it to the setting's type
+     *
+     * @param obj the json object describing the setting
+     * @param value the value to check, converted in place
+     * @return bool false if the value is not valid for the setting
+     */
+    static bool convertValue(const QJsonObject& obj, QVariant& value);
+
     void addItem(const QString &text, const QVariant &userData);
 
     /**
@@ -302,6 +546,14 @@ public:
      */
     void saveSetting();
 
+    QVariant value() const;
+
+    QVariant defaultValue() const;
+
+    bool isDefault() const;
+
+    void setValue(const QVariant& value);
+
 protected:
 
     /**
@@ -315,11 +567,52 @@ private:
 
     QComboBox* _combobox;
     QVariant _default_value;
+
+    QString _provider;
+
+    QJsonObject _provider_args;
+
+    QFutureWatcher<QVariantMap>* _options_watcher = nullptr;
+
+    /**
+     * @brief The version of the cached options shown in the combobox, -1 if none are shown
+     */
+    int _options_version = -1;
+
+    void setupLayout(const QString& title);
+
+    /**
+     * @brief Select the item with the value, items of providers that aren't loaded yet are added
+     */
+    void selectValue(const QVariant& value);
+
+    /**
+     * @brief Show the cached options of the provider and reload them if they expired
+     */
+    void loadOptions();
+
+    void finishLoadingOptions();
+
+    void setOptions(const QVariantMap& options);
+
+    QString providerKey() const;
 };
 
 
 typedef SettingItem* (*SettingItemFactory)(QJsonObject, QSettings*, QWidget*);
 typedef QMap<QString, SettingItemFactory> SettingsTypeMap;
+typedef bool (*SettingValueConverter)(const QJsonObject&, QVariant&);
+typedef QVariant (*SettingValueReader)(QSettings*, const QString&, const QString&);
+typedef void (*SettingValueWriter)(QSettings*, const QString&, const QString&, const QVariant&);
+
+/**
+ * @brief Custom storage layout for types whose value is not stored in a single key
+ */
+struct SettingValueStorage
+{
+    SettingValueReader reader;
+    SettingValueWriter writer;
+};
 
 
 // SettingItem creation from json
@@ -331,9 +624,77 @@ namespace SettingItemCreation
      *
      * @param identifier Corresponds to the "type" field in the json object
      * @param factory The function that creates the new SettingItem
+     * @param converter Optional function that checks and converts values for imports, values of types
+     * without converter are accepted as they are
+     * @return void
+     */
+    void registerType(QString identifier, SettingItemFactory factory, SettingValueConverter converter = nullptr);
+
+    /**
+     * @brief Whether a type was registered
+     *
+     * @return bool
+     */
+    bool isRegistered(const QString& identifier);
+
+    /**
+     * @brief Check a value against the json description of a setting and convert it to the setting's type
+     *
+     * @param json Json object describing the setting
+     * @param value The value to check, converted in place
+     * @return bool false if the value is not valid for the setting
+     */
+    bool convertValue(const QJsonObject& json, QVariant& value);
+
+    /**
+     * @brief Get the default value of a setting, settings without a default start from the empty value of their type
+     *
+     * @param json Json object describing the setting
+     * @return QVariant the default or an invalid QVariant if it isn't known or not valid for the setting
+     */
+    QVariant defaultValue(const QJsonObject& json);
+
+    /**
+     * @brief Register a custom storage layout for a type. Types without custom storage keep their value
+     * in the key "section/key".
+     *
+     * @param identifier Corresponds to the "type" field in the json object
+     * @param storage Functions to read and write the stored value
+     * @return void
+     */
+    void registerStorage(QString identifier, SettingValueStorage storage);
+
+    /**
+     * @brief Read the stored value of the setting described by a json object
+     *
+     * @param json Json object describing the setting
+     * @return QVariant the stored value or an invalid QVariant if nothing is stored
+     */
+    QVariant readValue(const QJsonObject& json, QSettings* settings);
+
+    /**
+     * @brief Read the value of the setting described by a json object from the user layer only
+     *
+     * @param json Json object describing the setting
+     * @return QVariant the value or an invalid QVariant if the user layer doesn't contain it
+     */
+    QVariant readUserValue(const QJsonObject& json, QSettings* settings);
+
+    /**
+     * @brief Write the value of the setting described by a json object
+     *
+     * @param json Json object describing the setting
+     * @param value The new value
      * @return void
      */
-    void registerType(QString identifier, SettingItemFactory factory);
+    void writeValue(const QJsonObject& json, QSettings* settings, const QVariant& value);
+
+    /**
+     * @brief Whether a type uses a custom storage layout
+     *
+     * @return bool
+     */
+    bool hasCustomStorage(const QString& identifier);
 
     /**
      * @brief Create a SettingItem from the supplied json object. Returns nullptr when the type was not registered
@@ -0,0 +1,145 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SETTINGLITEITEM_H
+#define SETTINGLITEITEM_H
+
+#include <QPointer>
+
+#include "settingitems.h"
+
+
+/**
+ * @brief Lightweight stand-in for a SettingItem described by json
+ *
+ * The title and the current value are painted directly instead of using a layout, a label and
+ * editor widgets. The real SettingItem of the type is only created as editor when the item gets
+ * the focus or is clicked, the click is passed on to it. Values are read and written the same
+ * way as by the real item, so an item can be switched between both modes without changing the
+ * stored settings.
+ */
+class SettingLiteItem : public SettingItem
+{
+    Q_OBJECT
+
+public:
+
+    SettingLiteItem(QJsonObject json, QSettings* settings, QWidget* parent = 0);
+
+    /**
+     * @brief Create a SettingLiteItem for a json object of any registered type
+     *
+     * @return SettingItem* nullptr if the type is not registered or mandatory fields are missing
+     */
+    static SettingItem* fromJsonObject(QJsonObject obj, QSettings* settings, QWidget* parent = 0);
+
+    /**
+     * @brief Restore the default value
+     *
+     * @return void
+     */
+    void restoreDefault();
+
+    /**
+     * @brief Save the setting
+     *
+     * @return void
+     */
+    void saveSetting();
+
+    QVariant value() const;
+
+    QVariant defaultValue() const;
+
+    bool isDefault() const;
+
+    void setValue(const QVariant& value);
+
+    /**
+     * @brief The real SettingItem, nullptr until the item was activated
+     *
+     * @return SettingItem*
+     */
+    SettingItem* editor() const;
+
+    /**
+     * @brief Create the real SettingItem with the current value, does nothing if it already exists
+     *
+     * @return void
+     */
+    void activate();
+
+    QSize sizeHint() const;
+
+    QSize minimumSizeHint() const;
+
+protected:
+
+    /**
+     * @brief Load the setting
+     *
+     * @return void
+     */
+    void loadSetting();
+
+    void paintEvent(QPaintEvent* event);
+
+    void mousePressEvent(QMouseEvent* event);
+
+    void mouseReleaseEvent(QMouseEvent* event);
+
+    void focusInEvent(QFocusEvent* event);
+
+private:
+
+    QJsonObject _json;
+
+    QString _title;
+
+    QVariant _value;
+
+    QVariant _default_value;
+
+    SettingItem* _editor = nullptr;
+
+    /**
+     * @brief The widget of the editor that received a forwarded mouse press and gets the release
+     */
+    QPointer<QWidget> _click_target;
+
+    /**
+     * @brief The first widget of the editor that accepts the focus
+     */
+    QPointer<QWidget> _focus_target;
+
+    bool isCheckable() const;
+
+    /**
+     * @brief The value as shown by the editor
+     */
+    QString displayText() const;
+
+    /**
+     * @brief The rectangles of the title and the value in the same place as in the layout of the editor
+     */
+    void itemRects(QRect& title_rect, QRect& value_rect) const;
+};
+
+#endif // SETTINGLITEITEM_H
@@ -0,0 +1,85 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SETTINGSACCESSORS_H
+#define SETTINGSACCESSORS_H
+
+#include <QJsonObject>
+#include <QSettings>
+#include <QVariant>
+
+#include "settingitems.h"
+
+
+/**
+ * @brief Typed access to settings described by the structs generated with settingswidget_generate_accessors
+ *
+ * A generated key struct provides the value type (Type), section(), key() and the json description (json()),
+ * so a misspelled setting or a value of the wrong type is a compile error:
+ *
+ *     bool enabled = readSetting<example::logging::enabled>(settings);
+ *     writeSetting<example::logging::enabled>(settings, false);
+ *
+ * Values are read and written like the SettingItems do, including custom storage and the SettingsStore
+ * attached to the settings.
+ */
+
+/**
+ * @brief The default value of a setting
+ *
+ * @return Key::Type
+ */
+template<typename Key>
+typename Key::Type settingDefault()
+{
+    return Key::json().value("default").toVariant().value<typename Key::Type>();
+}
+
+/**
+ * @brief Read a setting
+ *
+ * @param settings the settings the value is stored in
+ * @return Key::Type the stored value or the default if nothing is stored
+ */
+template<typename Key>
+typename Key::Type readSetting(QSettings* settings)
+{
+    QVariant value = SettingItemCreation::readValue(Key::json(), settings);
+    if (!value.isValid())
+    {
+        return settingDefault<Key>();
+    }
+    return value.value<typename Key::Type>();
+}
+
+/**
+ * @brief Write a setting
+ *
+ * @param settings the settings the value is stored in
+ * @param value the new value
+ * @return void
+ */
+template<typename Key>
+void writeSetting(QSettings* settings, const typename Key::Type& value)
+{
+    SettingItemCreation::writeValue(Key::json(), settings, QVariant::fromValue(value));
+}
+
+#endif // SETTINGSACCESSORS_H
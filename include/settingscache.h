@@ -0,0 +1,154 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SETTINGSCACHE_H
+#define SETTINGSCACHE_H
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <QHash>
+#include <QString>
+#include <QVariant>
+
+
+/**
+ * @brief Thread safe read cache with an immutable snapshot of all settings
+ *
+ * The GUI thread publishes a new snapshot (e.g. SettingsWidget does on every save), worker threads
+ * read from the current one without locking and without allocating. Snapshots are swapped atomically
+ * and replaced snapshots are freed once no reader can use them any more (epoch based reclamation).
+ *
+ * Reads are wait-free: a reader announces the current epoch, loads the snapshot and clears the
+ * announcement, a fixed number of atomic operations that never retry, whatever the writer does.
+ * This holds for the first 256 threads that read at the same time (see _max_readers), reads of
+ * further threads take a mutex that the writer also takes while freeing snapshots.
+ *
+ * Keys keep their index across snapshots, so hot loops can resolve the index once with indexOf
+ * and skip the hash lookup afterwards.
+ */
+class SettingsCache
+{
+public:
+
+    SettingsCache();
+
+    /**
+     * @brief Destroy the cache. No thread may read from it anymore.
+     */
+    ~SettingsCache();
+
+    SettingsCache(const SettingsCache&) = delete;
+
+    SettingsCache& operator=(const SettingsCache&) = delete;
+
+    /**
+     * @brief Replace the snapshot. Must not be called concurrently from several threads.
+     *
+     * Keys that are not in values keep their value from the previous snapshot.
+     *
+     * @param values the values by full key ("section/key")
+     * @return void
+     */
+    void publish(const QVariantHash& values);
+
+    /**
+     * @brief The number of published snapshots
+     *
+     * @return quint64
+     */
+    quint64 generation() const;
+
+    /**
+     * @brief The stable index of a key
+     *
+     * @param path the full key ("section/key")
+     * @return int the index or -1 if the key is not in the cache
+     */
+    int indexOf(const QString& path) const;
+
+    /**
+     * @brief Get a value by index
+     *
+     * @return QVariant the value or an invalid QVariant if the index is not valid
+     */
+    QVariant value(int index) const;
+
+    /**
+     * @brief Get a value by full key
+     *
+     * @return QVariant the value or an invalid QVariant if the key is not in the cache
+     */
+    QVariant value(const QString& path) const;
+
+    QVariant value(const QString& section, const QString& key) const;
+
+private:
+
+    struct Snapshot
+    {
+        quint64 generation;
+        QHash<QString, int> index;
+        std::vector<QVariant> values;
+    };
+
+    /**
+     * @brief Maximum number of threads that read without locking, further threads use a mutex
+     */
+    static const int _max_readers = 256;
+
+    std::atomic<const Snapshot*> _current;
+
+    /**
+     * @brief Incremented whenever a snapshot is replaced, starts at 1
+     */
+    std::atomic<quint64> _epoch;
+
+    /**
+     * @brief The epoch each reading thread announced before loading the snapshot, 0 if it doesn't read
+     */
+    mutable std::atomic<quint64> _reader_epochs[_max_readers];
+
+    struct Retired
+    {
+        const Snapshot* snapshot;
+        /**
+         * @brief Readers that announced a later epoch can't use the snapshot
+         */
+        quint64 epoch;
+    };
+
+    /**
+     * @brief Snapshots that were replaced but may still be in use
+     */
+    std::vector<Retired> _retired;
+
+    /**
+     * @brief Guards reads of threads without reader slot against reclamation
+     */
+    mutable std::mutex _fallback_mutex;
+
+    template<typename Read>
+    QVariant read(Read reader) const;
+
+    void reclaim();
+};
+
+#endif // SETTINGSCACHE_H
@@ -0,0 +1,141 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SETTINGSDIFF_H
+#define SETTINGSDIFF_H
+
+#include <functional>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QSettings>
+#include <QStringList>
+#include <QVariant>
+
+
+/**
+ * @brief Typed comparison of two settings sources against the schemas of the panels
+ *
+ * Values of settings in the schemas are converted to their type before comparing them, numeric
+ * values are equal when they round to the same value at their "decimals" and options are shown by
+ * their label.
+ * Keys that are not part of any schema are compared as they are stored.
+ *
+ * The differences are passed to a callback one at a time, ordered by panel (in the order the panels
+ * were added, unknown keys last), section and key. Only the keys of both sources are kept in memory.
+ */
+class SettingsDiff
+{
+public:
+
+    /**
+     * @brief Kind of a difference
+     *
+     * Changed: both sources have a different value, OnlyLeft/OnlyRight: only one source has a value,
+     * DefaultEqual: only one source has a value, but it is the default, so both sources behave the same.
+     */
+    enum Kind : int8_t {Changed, OnlyLeft, OnlyRight, DefaultEqual};
+
+    struct Difference
+    {
+        Kind kind;
+        /**
+         * @brief Name of the panel containing the setting, empty for keys not in any schema
+         */
+        QString panel;
+        QString section;
+        QString key;
+        /**
+         * @brief The values converted to the type of the setting, invalid if missing
+         */
+        QVariant left;
+        QVariant right;
+        /**
+         * @brief The values for display, e.g. the label of an option
+         */
+        QString left_text;
+        QString right_text;
+    };
+
+    typedef std::function<void(const Difference&)> Callback;
+
+    /**
+     * @brief Add the settings of a panel
+     *
+     * @param name the name of the panel
+     * @param schema the json array describing the panel, includes are expanded
+     * @return void
+     */
+    void addPanel(const QString& name, const QJsonArray& schema);
+
+    /**
+     * @brief Add the settings of a panel described in a json file
+     *
+     * @return bool false if the file can't be loaded
+     */
+    bool addPanel(const QString& name, const QString& filename);
+
+    /**
+     * @brief Compare two settings sources
+     *
+     * @param left the first source, e.g. staging
+     * @param right the second source, e.g. production
+     * @param callback called for every difference
+     * @return int the number of differences
+     */
+    int compare(QSettings* left, QSettings* right, const Callback& callback) const;
+
+    /**
+     * @brief A short name of a kind of difference
+     *
+     * @return QString
+     */
+    static QString kindName(Kind kind);
+
+private:
+
+    struct Setting
+    {
+        int panel;
+        QJsonObject json;
+    };
+
+    QStringList _panels;
+
+    /**
+     * @brief Settings of all panels by full key ("section/key")
+     */
+    QHash<QString, Setting> _settings;
+
+    void addSettings(int panel, const QJsonArray& schema);
+
+    /**
+     * @brief The full key of the setting a stored key belongs to, e.g. for rows of tables
+     */
+    QString settingPath(const QString& key) const;
+
+    QVariant read(QSettings* settings, const QString& path, const Setting* setting) const;
+
+    static bool equal(const QJsonObject& json, const QVariant& left, const QVariant& right);
+
+    static QString displayText(const QJsonObject& json, const QVariant& value);
+};
+
+#endif // SETTINGSDIFF_H
@@ -0,0 +1,87 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SETTINGSHELP_H
+#define SETTINGSHELP_H
+
+#include <QString>
+#include <QStringList>
+
+
+/**
+ * @brief Help texts of settings, looked up by their full key when they are needed
+ *
+ * The "desc" of a schema entry is handed over when the panel reads the schema, neither the entry nor
+ * the item keeps a copy. Long descriptions don't have to be part of the schema. They can be kept in a
+ * help file, a json object of texts by full key ("section/key"), each a string or an array of paragraphs:
+ *
+ *     {"logging/file": ["Where the log is written.", "The file is rotated daily."]}
+ *
+ * A help file is registered for the settings it documents and only read when the first help text of
+ * one of them is requested, e.g. by a tooltip. Other help files stay unread.
+ * SettingsWidget::addJsonPanel registers "<schema>.help.json" next to a schema file if it exists.
+ * A description from the schema takes precedence over a help file.
+ */
+namespace SettingsHelp
+{
+    /**
+     * @brief Set the description of a setting from its schema
+     *
+     * @param path the full key of the setting ("section/key")
+     * @param text the description, an empty text removes it
+     * @return void
+     */
+    void setDescription(const QString& path, const QString& text);
+
+    /**
+     * @brief Register a help file, it is read on the first request of a help text of one of its settings
+     *
+     * A file registered later for the same setting takes precedence.
+     *
+     * @param filename the json file
+     * @param paths the full keys of the settings documented by the file
+     * @return void
+     */
+    void addFile(const QString& filename, const QStringList& paths);
+
+    /**
+     * @brief The help file belonging to a schema file, e.g. "example.help.json" for "example.json"
+     *
+     * @return QString
+     */
+    QString helpFileFor(const QString& schema_file);
+
+    /**
+     * @brief The help text of a setting
+     *
+     * @param path the full key of the setting ("section/key")
+     * @return QString an empty string if there is no help text
+     */
+    QString text(const QString& path);
+
+    /**
+     * @brief Drop all descriptions, loaded texts and registered files
+     *
+     * @return void
+     */
+    void clear();
+}
+
+#endif // SETTINGSHELP_H
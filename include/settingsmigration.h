@@ -0,0 +1,80 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SETTINGSMIGRATION_H
+#define SETTINGSMIGRATION_H
+
+#include <functional>
+#include <QJsonObject>
+#include <QSettings>
+#include <QString>
+#include <QVariant>
+
+
+/**
+ * @brief Versioned migrations of stored values declared in a schema
+ *
+ * A schema entry of type "migrations" lists steps that bring values stored by older versions of the
+ * schema up to date:
+ *
+ *     {"type": "migrations", "name": "example", "steps": [
+ *         {"version": 2, "move": "generic/old_key", "to": "generic/new_key"},
+ *         {"version": 3, "transform": "logging/level", "map": {"verbose": 2, "quiet": 0}},
+ *         {"version": 4, "transform": "server/timeout", "function": "msec_to_sec"}
+ *     ]}
+ *
+ * "move" (or "rename") moves a value to another section and/or key unless the target already has a
+ * value, "transform" replaces a value using a map of old to new values or a registered function.
+ * The version of the applied migrations is stored as "schema_version/<name>". Steps with a higher
+ * version run once, in order of their version, and all their changes are written in one batch.
+ * Once the stored version is up to date, checking it is the only cost. Only plain values are migrated,
+ * not the rows of lists and tables.
+ */
+namespace SettingsMigration
+{
+    typedef std::function<QVariant(const QVariant&)> Transform;
+
+    /**
+     * @brief Register a function that can be referenced by "function" in a transform step
+     *
+     * @param name the name used in the json description
+     * @param transform receives the stored value and returns the new one
+     * @return void
+     */
+    void registerTransform(QString name, Transform transform);
+
+    /**
+     * @brief Apply the pending steps of a "migrations" entry
+     *
+     * @param migrations the json object of type "migrations"
+     * @param settings the storage to migrate
+     * @return int the number of steps that were applied
+     */
+    int migrate(const QJsonObject& migrations, QSettings* settings);
+
+    /**
+     * @brief The version that is stored for migrations with the name
+     *
+     * @return int 0 if no migration ran so far
+     */
+    int storedVersion(const QString& name, QSettings* settings);
+}
+
+#endif // SETTINGSMIGRATION_H
@@ -21,10 +21,13 @@
 #ifndef SETTINGSPANEL_H
 #define SETTINGSPANEL_H
 
+#include <vector>
 #include <QWidget>
 #include <QJsonArray>
 
 #include "settingitems.h"
+#include "settingcondition.h"
+#include "settingsschema.h"
 
 
 /**
@@ -37,16 +40,48 @@ class SettingsPanel : public QScrollArea
 
 public:
 
+    /**
+     * @brief The current values of all settings of a panel, see snapshot()
+     */
+    struct Snapshot
+    {
+        /**
+         * @brief Value of each entry in display order, invalid for titles and groups
+         */
+        std::vector<QVariant> values;
+        /**
+         * @brief The entries of the panel the snapshot belongs to
+         */
+        int generation = -1;
+    };
+
     SettingsPanel(QSettings* settings, QWidget* parent = 0);
 
     /**
      * @brief Generate a SettingsPanel from a json array
      *
+     * In progressive mode only the first screenful of SettingItems is constructed right away,
+     * the rest is constructed in small time slices from the event loop.
+     *
      * @param json A json array with information on how to fill the panel
      * @param parent The panel's parent
+     * @param progressive Construct the SettingItems progressively
+     * @param lite Construct SettingLiteItems, see setLiteItems
      * @return SettingsPanel*
      */
-    static SettingsPanel* fromJson(QJsonArray json, QSettings* settings, QWidget* parent = 0);
+    static SettingsPanel* fromJson(QJsonArray json, QSettings* settings, QWidget* parent = 0, bool progressive = false,
+                                   bool lite = false);
+
+    /**
+     * @brief Construct settings described by json as SettingLiteItems
+     *
+     * Lite items paint their title and value and only create the real SettingItem when they
+     * get the focus or are clicked. Applies to items constructed afterwards.
+     *
+     * @param lite whether to construct lite items
+     * @return void
+     */
+    void setLiteItems(bool lite);
 
     /**
      * @brief Add a new SettingItem to the panel
@@ -65,6 +100,33 @@ public:
 
     void addTitle(QString title);
 
+    /**
+     * @brief Add a SettingItem, title or group described by a json object
+     *
+     * Entries with a "visible_if" condition are only constructed once the condition is met,
+     * entries with an "enabled_if" condition are disabled while the condition is not met.
+     * A "group" shows its "children" below a header that collapses and expands them. The children
+     * of a collapsed group ("expanded": false, the default) are constructed when it is expanded.
+     * Pending "migrations" are applied to the storage right away, see SettingsMigration.
+     *
+     * @param obj the json object
+     * @return void
+     */
+    void addJsonItem(QJsonObject obj);
+
+    /**
+     * @brief Update the panel to a changed json description in place
+     *
+     * Entries are matched by section/key (titles and groups by their title). Unchanged entries keep
+     * their widgets, changed entries are recreated with their unsaved value if it is still valid,
+     * and only entries that were added or removed are constructed or destroyed. The expansion of
+     * groups and the scroll position are kept. Entries added via code are removed.
+     *
+     * @param json the new json array
+     * @return void
+     */
+    void updateFromJson(QJsonArray json);
+
     /**
      * @brief Restore the default value for all SettingItems
      *
@@ -79,17 +141,389 @@ public:
      */
     void saveSettings();
 
+    /**
+     * @brief Reload all constructed SettingItems from the storage, discarding unsaved changes
+     *
+     * @return void
+     */
+    void reloadSettings();
+
+    /**
+     * @brief The full keys ("section/key") of all settings in this panel, constructed or not
+     *
+     * @return QStringList
+     */
+    QStringList settingPaths() const;
+
+    /**
+     * @brief The stored value of a setting in this panel, the default if nothing valid is stored
+     *
+     * @param path the full key ("section/key")
+     * @return QVariant invalid if the setting is not part of the panel
+     */
+    QVariant savedValue(const QString& path) const;
+
+    /**
+     * @brief Collect the user layer values of all settings in this panel that differ from their default
+     *
+     * @param values receives the values by full key ("section/key")
+     * @return void
+     */
+    void collectChangedValues(QVariantHash& values) const;
+
+    /**
+     * @brief Collect the stored values of all settings in this panel, the default for settings without value
+     *
+     * @param values receives the values by full key ("section/key")
+     * @return void
+     */
+    void collectValues(QVariantHash& values) const;
+
+    /**
+     * @brief Collect the current, possibly unsaved values of all settings in this panel
+     *
+     * @param values receives the values by full key ("section/key")
+     * @return void
+     */
+    void collectCurrentValues(QVariantHash& values) const;
+
+    /**
+     * @brief Change many settings at once without saving them
+     *
+     * The signals of the SettingItems are blocked and the panel is repainted and updates its
+     * conditions only once. Keys that are not part of the panel are ignored.
+     *
+     * @param values the new values by full key ("section/key")
+     * @return int the number of values that were applied
+     */
+    int applyValues(const QVariantHash& values);
+
+    /**
+     * @brief Take the current, possibly unsaved values of all settings in one pass
+     *
+     * Unlike collectCurrentValues the values are stored by position, so restoring them needs
+     * neither lookups nor conversions.
+     *
+     * @return Snapshot
+     */
+    Snapshot snapshot() const;
+
+    /**
+     * @brief Restore a snapshot of this panel without saving it
+     *
+     * The signals of the SettingItems are blocked and the panel updates its conditions once.
+     * Only values that differ from the current ones mark the panel dirty.
+     *
+     * @param snapshot the snapshot, its values are moved into the panel
+     * @return bool false if the entries of the panel changed since the snapshot was taken
+     */
+    bool applySnapshot(Snapshot snapshot);
+
+    /**
+     * @brief The presets defined in the json description ("type": "preset")
+     *
+     * @return QHash<QString, QVariantHash> the values of each preset by name
+     */
+    QHash<QString, QVariantHash> presets() const;
+
+    /**
+     * @brief Whether any setting changed since the last save or reload
+     *
+     * @return bool
+     */
+    bool isDirty() const;
+
+    /**
+     * @brief Check a value against the type of a setting and convert it
+     *
+     * @param path the full key of the setting
+     * @param value the value to check, converted in place
+     * @return bool false if the setting is unknown or the value is not valid for it
+     */
+    bool convertValue(const QString& path, QVariant& value) const;
+
+    /**
+     * @brief Whether SettingItems are still being constructed progressively
+     *
+     * @return bool
+     */
+    bool isConstructing() const;
+
+    /**
+     * @brief Construct all remaining SettingItems right away
+     *
+     * @return void
+     */
+    void finishConstruction();
+
+    /**
+     * @brief The number of constructed widgets of SettingItems, titles and groups
+     *
+     * @return int
+     */
+    int constructedCount() const;
+
+    /**
+     * @brief Rough estimate of the memory used by the constructed widgets in bytes
+     *
+     * @return qint64
+     */
+    qint64 estimatedWidgetMemory() const;
+
+    /**
+     * @brief Destroy the widgets of all entries described by json until the panel is shown again
+     *
+     * Unsaved values are kept in the panel and applied when the widgets are constructed again.
+     * Entries added via code are kept. Nothing is evicted during progressive construction.
+     *
+     * @return int the number of destroyed widgets
+     */
+    int evictWidgets();
+
+    /**
+     * @brief Set the time budget for each slice of progressive construction
+     *
+     * @param msec the budget in milliseconds
+     * @return void
+     */
+    void setConstructionBudget(int msec);
+
+    /**
+     * @brief Write values of settings in this panel to the storage without touching the SettingItems
+     *
+     * @param values the values by full key ("section/key"), unknown keys are ignored
+     * @return void
+     */
+    void writeValues(const QVariantHash& values);
+
+signals:
+
+    /**
+     * @brief Progress of the progressive construction, first emitted from the event loop after fromJson returned
+     *
+     * @param done number of entries that have been processed
+     * @param total number of entries in the panel
+     */
+    void constructionProgress(int done, int total);
+
+    /**
+     * @brief All visible SettingItems have been constructed
+     */
+    void constructionFinished();
+
+    /**
+     * @brief The panel got its first unsaved change or was saved or reloaded
+     */
+    void dirtyChanged(bool dirty);
+
+protected:
+
+    /**
+     * @brief Construct the widgets again after they were evicted
+     */
+    void showEvent(QShowEvent* event);
+
 private:
 
     /**
-     * @brief List of all the SettingItems in this panel
+     * @brief A SettingItem or title of the panel, possibly not constructed yet
+     */
+    struct Entry
+    {
+        /**
+         * @brief Description for deferred construction, empty for entries added via code
+         */
+        QJsonObject json;
+        /**
+         * @brief section/key of the setting, empty for titles
+         */
+        QString path;
+        QWidget* widget = nullptr;
+        SettingItem* item = nullptr;
+        SettingCondition visible_if;
+        SettingCondition enabled_if;
+        bool visible = true;
+        bool resolved = false;
+        bool resolving = false;
+        bool failed = false;
+        /**
+         * @brief Value to apply once the entry is constructed or to write on save, e.g. a restored default
+         */
+        QVariant pending;
+        /**
+         * @brief Index of the group containing the entry, -1 for top level entries
+         */
+        int parent = -1;
+        bool group = false;
+        bool expanded = false;
+        /**
+         * @brief For groups: one past the index of the last descendant
+         */
+        int end = 0;
+        /**
+         * @brief For groups: the widget the children are laid out in
+         */
+        QWidget* container = nullptr;
+    };
+
+    /**
+     * @brief All entries of the panel in display order
+     */
+    std::vector<Entry> _entries;
+
+    /**
+     * @brief Entry index for each section/key
+     */
+    QHash<QString, int> _index;
+
+    /**
+     * @brief Entries with conditions referencing a section/key
+     */
+    QHash<QString, QVector<int>> _dependents;
+
+    /**
+     * @brief Entries that changed since the last save or reload
+     */
+    QSet<int> _dirty;
+
+    QHash<QString, QVariantHash> _presets;
+
+    /**
+     * @brief Changes whenever entries are added, to detect outdated snapshots
+     */
+    int _generation = 0;
+
+    /**
+     * @brief Current value of an entry: the item's value, the pending value or the stored value
+     */
+    QVariant currentValue(const Entry& entry) const;
+
+    /**
+     * @brief Index of the last entry whose widget was appended to the layout
+     */
+    int _last_constructed = -1;
+
+    /**
+     * @brief Set when entries are added in bulk and construction happens afterwards
+     */
+    bool _building = false;
+
+    /**
+     * @brief Construct SettingLiteItems instead of the real SettingItems
+     */
+    bool _lite = false;
+
+    /**
+     * @brief Set when the widgets were evicted, nothing is constructed until the panel is shown
+     */
+    bool _evicted = false;
+
+    /**
+     * @brief Next entry for progressive construction, -1 if there is none
+     */
+    int _next_construct = -1;
+
+    /**
+     * @brief Time budget for a slice of progressive construction in milliseconds
      */
-    std::list<SettingItem*> _items = {};
+    int _construction_budget = 8;
+
+    QTimer* _construction_timer = nullptr;
+
+    /**
+     * @brief Construct the entries that fit into the first screen and schedule the rest
+     */
+    void startProgressiveConstruction();
+
+    void constructSlice();
 
     /**
      * @brief The settings to use
      */
     QSettings* _settings;
+
+    QLabel* createTitle(QString title);
+
+    QWidget* createGroup(int idx);
+
+    void connectGroup(int idx);
+
+    /**
+     * @brief Identity of each entry for matching entries of a changed description
+     */
+    static QStringList entryKeys(const std::vector<Entry>& entries);
+
+    /**
+     * @brief Whether two entries have the same description, children of groups are compared on their own
+     */
+    static bool sameDescription(const Entry& a, const Entry& b);
+
+    /**
+     * @brief Add a json entry and, for groups, its children
+     */
+    void addJsonEntry(const QJsonObject& obj, int parent);
+
+    /**
+     * @brief The stored value of an entry converted to its type, invalid if nothing valid is stored
+     *
+     * With user_only the value is read from the user layer alone.
+     */
+    QVariant storedValue(const Entry& entry, bool user_only = false) const;
+
+    QVariant defaultValue(const Entry& entry) const;
+
+    int addEntry(Entry entry);
+
+    /**
+     * @brief Evaluate the visibility of an entry if it is not known yet
+     */
+    bool resolveVisibility(int idx);
+
+    /**
+     * @brief Construct, show or hide an entry according to its visibility
+     */
+    void applyVisibility(int idx);
+
+    void applyEnabled(int idx);
+
+    /**
+     * @brief Whether an entry is visible and all groups containing it are visible and expanded
+     */
+    bool isShown(int idx) const;
+
+    void setExpanded(int idx, bool expanded);
+
+    /**
+     * @brief Construct all descendants of a group that are shown
+     */
+    void constructChildren(int idx);
+
+    void construct(int idx);
+
+    void insertWidget(int idx, QWidget* widget);
+
+    /**
+     * @brief Value of a referenced setting for condition evaluation
+     */
+    QVariant conditionValue(const QString& path);
+
+    /**
+     * @brief Re-evaluate the conditions of all entries downstream of a changed setting
+     */
+    void updateDependents(const QString& path);
+
+    void updateDependents(const QStringList& paths);
+
+    void markDirty(int idx);
+
+    void clearDirty();
+
+    /**
+     * @brief Update conditions and the dirty state after values were changed with blocked signals
+     */
+    void finishBatch(const QStringList& changed, bool was_dirty);
+
+    void connectItem(int idx);
 };
 
 #endif // SETTINGSPANEL_H
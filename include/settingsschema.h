@@ -0,0 +1,93 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SETTINGSSCHEMA_H
+#define SETTINGSSCHEMA_H
+
+#include <QJsonArray>
+#include <QString>
+#include <QStringList>
+
+
+/**
+ * @brief Loading of json schemas with includes and shared fragments
+ *
+ * Entries of a schema array can be replaced by the entries of another array:
+ *
+ *     {"$include": "connection.json", "section": "database"}
+ *     {"$ref": "logging", "section": "server/logging", "level": "debug"}
+ *
+ * "$include" inserts the array in a file (relative to the including file), "$ref" a named fragment,
+ * which is registered in code or defined in a schema by an entry {"$fragment": "logging", "items": [...]}.
+ * All other members of the entry are parameters: "${name}" in strings and member names of the fragment
+ * is replaced by the parameter, and the "section" parameter is also used for entries without section.
+ * Directives are expanded in the "children" of groups as well.
+ *
+ * Files are parsed once and expanded fragments are cached per parameter set, shared by all panels.
+ * A cached expansion is rebuilt when any file it was built from, nested includes included, changed.
+ * Fragment names are global: a fragment defined again elsewhere with other entries replaces the first
+ * definition with a warning.
+ */
+namespace SettingsSchema
+{
+    /**
+     * @brief Load and expand a schema file
+     *
+     * @param filename the json file containing a schema array
+     * @param ok is set to false if the file can't be read or is no array
+     * @return QJsonArray the expanded schema
+     */
+    QJsonArray load(const QString& filename, bool* ok = nullptr);
+
+    /**
+     * @brief Expand all includes and references of a schema
+     *
+     * @param schema the schema array
+     * @param base_dir the directory relative includes are resolved against, the current directory if empty
+     * @return QJsonArray the schema itself if it contains no includes or references
+     */
+    QJsonArray expand(const QJsonArray& schema, const QString& base_dir = QString());
+
+    /**
+     * @brief The schema file and all files it includes, directly or indirectly
+     *
+     * @param filename the json file containing a schema array
+     * @return QStringList absolute paths, starting with the file itself
+     */
+    QStringList includedFiles(const QString& filename);
+
+    /**
+     * @brief Register a fragment that can be referenced with "$ref"
+     *
+     * @param name the name of the fragment
+     * @param fragment the entries of the fragment
+     * @return void
+     */
+    void registerFragment(const QString& name, const QJsonArray& fragment);
+
+    /**
+     * @brief Drop all parsed files and expanded fragments
+     *
+     * @return void
+     */
+    void clearCache();
+}
+
+#endif // SETTINGSSCHEMA_H
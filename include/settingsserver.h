@@ -0,0 +1,212 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SETTINGSSERVER_H
+#define SETTINGSSERVER_H
+
+#include <QHash>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSet>
+#include <QStringList>
+#include <QVariant>
+
+#include "settingswidget.h"
+
+
+/**
+ * @brief Message types of the local settings protocol
+ *
+ * Every message is a frame of a quint32 length followed by a QDataStream (Qt 5.12) payload that
+ * starts with the quint8 type and a quint32 request id. Replies carry the id of their request.
+ *
+ *  - Get: QStringList keys, answered by GetReply: QVariantHash values (saved values, unknown keys are missing)
+ *  - Set: QVariantHash values, bool save, answered by SetReply: qint32 applied, QStringList unknown, QStringList rejected
+ *  - Subscribe/Unsubscribe: QStringList key prefixes (an empty prefix matches all keys), answered by
+ *    SubscribeReply without body
+ *  - Notification (id 0): QVariantHash changed values, sent to subscribers whenever saved values change
+ *  - Error: QString message
+ */
+namespace SettingsProtocol
+{
+    enum MessageType : quint8 {Get = 1, Set = 2, Subscribe = 3, Unsubscribe = 4,
+                               GetReply = 0x81, SetReply = 0x82, SubscribeReply = 0x83,
+                               Notification = 0x90, Error = 0xff};
+
+    /**
+     * @brief Frames bigger than this are rejected and the connection is closed
+     */
+    const quint32 max_frame_size = 16 * 1024 * 1024;
+}
+
+
+/**
+ * @brief Local socket endpoint that lets other processes on the host query and change settings
+ *
+ * Sets are applied to the panels of the SettingsWidget like edits of the user, so they are tracked as
+ * unsaved changes and are saved with the rest of the settings, or right away if requested. Change
+ * notifications need a SettingsStore attached to the settings of the widget.
+ */
+class SettingsServer : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * @brief Create a server for the panels of a widget
+     *
+     * @param widget the widget holding the panels
+     * @param settings the settings of the widget, used to watch for changes
+     */
+    SettingsServer(SettingsWidget* widget, QSettings* settings, QObject* parent = 0);
+
+    /**
+     * @brief Start listening
+     *
+     * Only the user running the server can connect. A socket left behind by a crashed server is
+     * replaced, a name another server still answers on is not.
+     *
+     * @param name the name of the local socket, a path or a name in the default directory
+     * @return bool false if the server could not be started
+     */
+    bool listen(const QString& name);
+
+    void close();
+
+    /**
+     * @brief The full path of the local socket
+     *
+     * @return QString
+     */
+    QString serverName() const;
+
+private:
+
+    struct Client
+    {
+        QByteArray buffer;
+        QStringList subscriptions;
+    };
+
+    SettingsWidget* _widget;
+
+    QLocalServer* _server;
+
+    QHash<QLocalSocket*, Client> _clients;
+
+    /**
+     * @brief Keys that changed since the last notification
+     */
+    QSet<QString> _changed;
+
+    void acceptConnections();
+
+    void readRequests(QLocalSocket* socket);
+
+    void handleRequest(QLocalSocket* socket, const QByteArray& payload);
+
+    void valueChanged(const QString& section, const QString& key);
+
+    /**
+     * @brief Send the collected changes to the subscribers, once per event loop iteration
+     */
+    void notifySubscribers();
+};
+
+
+/**
+ * @brief Client of a SettingsServer
+ *
+ * Requests return their id, the replies arrive asynchronously as signals.
+ */
+class SettingsClient : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    SettingsClient(QObject* parent = 0);
+
+    /**
+     * @brief Connect to a server
+     *
+     * @param name the name the server listens on
+     * @param msecs time to wait for the connection
+     * @return bool false if the connection failed
+     */
+    bool connectToServer(const QString& name, int msecs = 3000);
+
+    bool isConnected() const;
+
+    quint32 get(const QStringList& keys);
+
+    /**
+     * @brief Change settings
+     *
+     * @param values the new values by full key ("section/key")
+     * @param save save all settings right away instead of leaving the changes unsaved
+     * @return quint32 the request id
+     */
+    quint32 set(const QVariantHash& values, bool save = false);
+
+    quint32 subscribe(const QStringList& prefixes = QStringList(""));
+
+    quint32 unsubscribe(const QStringList& prefixes = QStringList(""));
+
+    /**
+     * @brief Process incoming data until a reply to a request arrived
+     *
+     * @param id the request id
+     * @param msecs the timeout
+     * @return bool false on timeout or disconnection
+     */
+    bool waitForReply(quint32 id, int msecs = 3000);
+
+signals:
+
+    void valuesReceived(quint32 id, const QVariantHash& values);
+
+    void setFinished(quint32 id, int applied, const QStringList& unknown, const QStringList& rejected);
+
+    void subscribed(quint32 id);
+
+    void valuesChanged(const QVariantHash& values);
+
+    void errorReceived(quint32 id, const QString& message);
+
+private:
+
+    QLocalSocket* _socket;
+
+    QByteArray _buffer;
+
+    quint32 _next_id;
+
+    quint32 _last_reply;
+
+    quint32 send(quint8 type, const QByteArray& body);
+
+    void readReplies();
+
+    void handleReply(const QByteArray& payload);
+};
+
+#endif // SETTINGSSERVER_H
@@ -0,0 +1,158 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SETTINGSSNAPSHOT_H
+#define SETTINGSSNAPSHOT_H
+
+#include <QObject>
+#include <QSharedMemory>
+#include <QVariant>
+
+#include "settingsstore.h"
+
+
+/**
+ * @brief Publishes the resolved values of a SettingsStore as a read-only snapshot in shared memory
+ *
+ * The snapshot is written whenever the store is synced. It consists of a sorted table of keys and
+ * values in a binary layout that SettingsSnapshotReader instances in other processes can read in place.
+ * Every publication increments the generation of the snapshot, so readers can cheaply check for updates.
+ *
+ * The data lives in the segment "<name>.<n>". A small directory segment "<name>" holds the current n,
+ * when a snapshot outgrows its segment a bigger one is created and readers follow the directory.
+ */
+class SettingsSnapshotPublisher : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * @brief Create the shared memory segments and publish the current values of the store
+     *
+     * @param name the name readers use to find the snapshot
+     * @param store the store whose values are published
+     * @param parent
+     */
+    SettingsSnapshotPublisher(const QString& name, SettingsStore* store, QObject* parent = 0);
+
+    /**
+     * @brief Write the current values of the store to shared memory
+     *
+     * @return bool false if the shared memory could not be created
+     */
+    bool publish();
+
+    /**
+     * @brief The generation of the last published snapshot
+     *
+     * @return quint32
+     */
+    quint32 generation() const;
+
+private:
+
+    QString _name;
+
+    SettingsStore* _store;
+
+    QSharedMemory _directory;
+
+    QSharedMemory _data;
+
+    quint32 _segment;
+
+    quint32 _generation;
+
+    bool createDirectory();
+
+    /**
+     * @brief Replace the data segment by one with at least size bytes
+     */
+    bool createSegment(int size);
+};
+
+
+/**
+ * @brief Read-only access to a snapshot published by a SettingsSnapshotPublisher
+ *
+ * Reads don't block the publisher: the publisher marks the snapshot as being written and a reader
+ * that overlapped with a write simply retries. Bools, numbers and strings are read directly from
+ * the shared memory, other types are stored with QDataStream.
+ */
+class SettingsSnapshotReader
+{
+public:
+
+    explicit SettingsSnapshotReader(const QString& name);
+
+    /**
+     * @brief Attach to the snapshot
+     *
+     * @return bool false if no snapshot with the name is published
+     */
+    bool attach();
+
+    bool isAttached() const;
+
+    /**
+     * @brief The generation of the current snapshot, 0 if not attached
+     *
+     * @return quint32
+     */
+    quint32 generation();
+
+    /**
+     * @brief Get a value of the snapshot
+     *
+     * @return QVariant the value or an invalid QVariant if the key is not in the snapshot
+     */
+    QVariant value(const QString& section, const QString& key);
+
+    /**
+     * @brief Get all values of the snapshot
+     *
+     * @return QVariantHash the values by full key ("section/key")
+     */
+    QVariantHash values();
+
+private:
+
+    QString _name;
+
+    QSharedMemory _directory;
+
+    QSharedMemory _data;
+
+    quint32 _segment;
+
+    /**
+     * @brief Follow the directory if the publisher moved to a new segment
+     */
+    bool ensureCurrent();
+
+    /**
+     * @brief Run read on a consistent state of the snapshot
+     */
+    template<typename Read>
+    bool readConsistent(Read read);
+};
+
+#endif // SETTINGSSNAPSHOT_H
@@ -0,0 +1,125 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SETTINGSSTATISTICS_H
+#define SETTINGSSTATISTICS_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QString>
+
+
+/**
+ * @brief Optional counters of the reads and writes of each key in the storage
+ *
+ * All storage calls of SettingsStore::readValue, writeValue, writeValues and removeValue are counted,
+ * so the loading and saving of SettingItems, the typed accessors and any other runtime access are
+ * included. Each thread counts into its own table, the tables are only combined when the statistics
+ * are collected. While disabled, which is the default, a storage call only checks a flag.
+ */
+namespace SettingsStatistics
+{
+    enum Operation : int8_t {Read, Write};
+
+    struct Counter
+    {
+        quint64 reads = 0;
+        quint64 writes = 0;
+        /**
+         * @brief Time spent in the storage calls in nanoseconds
+         */
+        qint64 nsecs = 0;
+    };
+
+    /**
+     * @brief Measures a storage call from construction to destruction if the statistics are enabled
+     */
+    class Timer
+    {
+    public:
+
+        Timer(Operation operation, const QString& section, const QString& key);
+
+        Timer(Operation operation, const QString& path);
+
+        ~Timer();
+
+    private:
+
+        Operation _operation;
+
+        /**
+         * @brief The full key, empty if the statistics are disabled
+         */
+        QString _path;
+
+        QElapsedTimer _timer;
+    };
+
+    /**
+     * @brief Enable or disable counting, the counts so far are kept
+     *
+     * @return void
+     */
+    void setEnabled(bool enabled);
+
+    bool isEnabled();
+
+    /**
+     * @brief Count a storage call
+     *
+     * @param operation whether the call read or wrote the key
+     * @param path the full key ("section/key")
+     * @param nsecs the duration of the call in nanoseconds
+     * @return void
+     */
+    void record(Operation operation, const QString& path, qint64 nsecs);
+
+    /**
+     * @brief The counters of all threads combined
+     *
+     * @return QHash<QString, Counter> the counters by full key ("section/key")
+     */
+    QHash<QString, Counter> collect();
+
+    /**
+     * @brief Reset the counters of all threads
+     *
+     * @return void
+     */
+    void reset();
+
+    /**
+     * @brief The combined counters as a json object of {"reads", "writes", "msec"} by full key
+     *
+     * @return QByteArray
+     */
+    QByteArray toJson();
+
+    /**
+     * @brief The combined counters as a text table, the most accessed keys first
+     *
+     * @return QString
+     */
+    QString toTable();
+}
+
+#endif // SETTINGSSTATISTICS_H
@@ -0,0 +1,360 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SETTINGSSTORE_H
+#define SETTINGSSTORE_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QSettings>
+#include <QStringList>
+#include <QVariant>
+
+
+/**
+ * @brief Layered settings storage with a resolved cache
+ *
+ * Values are looked up in the session, user, system and default layers (in that order).
+ * The result of the lookup is cached per key and only recomputed when one of the layers
+ * changes that key, so reads don't have to probe every layer.
+ *
+ * A store is attached to its user QSettings instance: SettingItems that were created
+ * with that QSettings pointer automatically read and write through the store.
+ *
+ * The user layer can be sharded into one INI file per top level section, so saving only
+ * rewrites the files of the sections that changed.
+ *
+ * The static accessors can count the accesses of each key, see SettingsStatistics.
+ */
+class SettingsStore : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    enum Layer : int8_t {DefaultLayer, SystemLayer, UserLayer, SessionLayer};
+
+    SettingsStore(QSettings* user, QSettings* system = 0, QObject* parent = 0);
+    ~SettingsStore();
+
+    /**
+     * @brief Get the store that is attached to the given QSettings instance
+     *
+     * @param settings the user settings of the store
+     * @return SettingsStore* or nullptr if there is no store for the settings
+     */
+    static SettingsStore* forSettings(QSettings* settings);
+
+    /**
+     * @brief Read a value through the store attached to settings or directly from settings
+     *
+     * @param settings the settings instance of the SettingItem
+     * @param section the section of the setting
+     * @param key the key of the setting
+     * @param default_value the value to use if no layer contains the key
+     * @return QVariant
+     */
+    static QVariant readValue(QSettings* settings, const QString& section, const QString& key,
+                              const QVariant& default_value);
+
+    /**
+     * @brief Read a value from the user layer only, without session overrides and the lower layers
+     *
+     * @param settings the settings instance of the SettingItem
+     * @param section the section of the setting
+     * @param key the key of the setting
+     * @return QVariant the value or an invalid QVariant if the user layer doesn't contain the key
+     */
+    static QVariant readUserValue(QSettings* settings, const QString& section, const QString& key);
+
+    /**
+     * @brief Whether the user layer contains the key or keys below it, for values stored in several keys
+     *
+     * @param settings the settings instance of the SettingItem
+     * @param section the section of the setting
+     * @param key the key of the setting
+     * @return bool
+     */
+    static bool containsUserValues(QSettings* settings, const QString& section, const QString& key);
+
+    /**
+     * @brief Write a value through the store attached to settings or directly to settings
+     *
+     * @param settings the settings instance of the SettingItem
+     * @param section the section of the setting
+     * @param key the key of the setting
+     * @param value the new value
+     * @return void
+     */
+    static void writeValue(QSettings* settings, const QString& section, const QString& key, const QVariant& value);
+
+    /**
+     * @brief Write many values at once. The caller is responsible for syncing the settings afterwards.
+     *
+     * @param settings the settings instance of the SettingItems
+     * @param values the new values by full key ("section/key")
+     * @return void
+     */
+    static void writeValues(QSettings* settings, const QVariantHash& values);
+
+    /**
+     * @brief Remove a value through the store attached to settings or directly from settings
+     *
+     * @return void
+     */
+    static void removeValue(QSettings* settings, const QString& section, const QString& key);
+
+    /**
+     * @brief Write pending changes to disk through the store attached to settings or directly
+     *
+     * @return void
+     */
+    static void syncSettings(QSettings* settings);
+
+    /**
+     * @brief Build the full key for a section/key pair
+     *
+     * @return QString
+     */
+    static QString path(const QString& section, const QString& key);
+
+    /**
+     * @brief Split a full key into section and key
+     *
+     * @return void
+     */
+    static void splitPath(const QString& path, QString& section, QString& key);
+
+    /**
+     * @brief Human readable name of a layer
+     *
+     * @return QString
+     */
+    static QString layerName(Layer layer);
+
+    QSettings* userSettings() const;
+
+    QSettings* systemSettings() const;
+
+    /**
+     * @brief Replace the system layer
+     *
+     * @param system the site-wide settings, may be nullptr
+     * @return void
+     */
+    void setSystemSettings(QSettings* system);
+
+    /**
+     * @brief Store the user layer in one INI file per top level section
+     *
+     * The files ("<section>.ini") are opened when a key of their section is accessed first and
+     * only files with changes are written on sync. When sharding is switched on, the keys of the
+     * user QSettings are moved to the shards unless a shard already contains them.
+     *
+     * @param directory the directory of the shards, sharding is disabled if empty
+     * @return void
+     */
+    void setShardDirectory(const QString& directory);
+
+    /**
+     * @brief The top level sections whose shards are open
+     *
+     * @return QStringList
+     */
+    QStringList loadedShards() const;
+
+    /**
+     * @brief Set the schema default for a key
+     *
+     * @return void
+     */
+    void setDefault(const QString& section, const QString& key, const QVariant& value);
+
+    /**
+     * @brief Override a key for this session only. Session values are never written to disk.
+     *
+     * @return void
+     */
+    void setSessionValue(const QString& section, const QString& key, const QVariant& value);
+
+    /**
+     * @brief Remove a session override
+     *
+     * @return void
+     */
+    void clearSessionValue(const QString& section, const QString& key);
+
+    /**
+     * @brief Parse session overrides from command line arguments of the form "--set section/key=value"
+     *
+     * @param arguments the command line arguments, e.g. QCoreApplication::arguments()
+     * @return int the number of overrides that were set
+     */
+    int parseArguments(const QStringList& arguments);
+
+    /**
+     * @brief Get the resolved value of a key
+     *
+     * @return QVariant the value or an invalid QVariant if no layer contains the key
+     */
+    QVariant value(const QString& section, const QString& key) const;
+
+    /**
+     * @brief Get the value stored in the user layer, ignoring all other layers
+     *
+     * @return QVariant the value or an invalid QVariant if the user layer doesn't contain the key
+     */
+    QVariant userValue(const QString& section, const QString& key) const;
+
+    /**
+     * @brief Get the layer the resolved value of a key comes from
+     *
+     * @return Layer
+     */
+    Layer layer(const QString& section, const QString& key) const;
+
+    /**
+     * @brief Write a value to the user layer
+     *
+     * A value that equals the one already stored in the user layer is not written again.
+     * Writing drops a session override of the key.
+     *
+     * @return void
+     */
+    void setValue(const QString& section, const QString& key, const QVariant& value);
+
+    /**
+     * @brief Remove a key from the user layer and drop its session override
+     *
+     * @return void
+     */
+    void remove(const QString& section, const QString& key);
+
+    /**
+     * @brief Recompute the resolved value of a key
+     *
+     * @return void
+     */
+    void invalidate(const QString& section, const QString& key);
+
+    /**
+     * @brief Reload a layer from disk and recompute all cached keys
+     *
+     * @return void
+     */
+    void reloadLayer(Layer layer);
+
+    /**
+     * @brief Get the resolved values of all keys that are contained in any layer
+     *
+     * @return QVariantHash the values by full key ("section/key")
+     */
+    QVariantHash values() const;
+
+    /**
+     * @brief Write the user layer to disk and notify about the saved state
+     *
+     * @return void
+     */
+    void sync();
+
+signals:
+
+    /**
+     * @brief The resolved value of a key changed
+     */
+    void valueChanged(const QString& section, const QString& key);
+
+    /**
+     * @brief The user layer was written to disk
+     */
+    void synced();
+
+private:
+
+    struct Resolved
+    {
+        QVariant value;
+        Layer layer;
+    };
+
+    const Resolved& resolve(const QString& path) const;
+
+    Resolved lookup(const QString& path) const;
+
+    /**
+     * @brief Recompute a cached key and notify about changes
+     */
+    void refresh(const QString& section, const QString& key);
+
+    /**
+     * @brief The user settings containing a key and the key inside them
+     */
+    QSettings* userSettingsFor(const QString& path, QString& user_key) const;
+
+    QSettings* shard(const QString& name) const;
+
+    void markShardDirty(const QString& path);
+
+    /**
+     * @brief Move the keys of the user QSettings to their shards and clear it
+     */
+    void moveUserValuesToShards();
+
+    /**
+     * @brief Full keys of the user layer, in sharded mode read from the shard files once and kept up to date by writes
+     */
+    QSet<QString> userPaths() const;
+
+    QSettings* _user;
+
+    QString _shard_directory;
+
+    /**
+     * @brief Open shards by top level section
+     */
+    mutable QHash<QString, QSettings*> _shards;
+
+    /**
+     * @brief Shards with changes that are not written yet
+     */
+    QSet<QString> _dirty_shards;
+
+    /**
+     * @brief Index of the keys in all shards, only valid if _user_paths_loaded
+     */
+    mutable QSet<QString> _user_paths;
+
+    mutable bool _user_paths_loaded;
+
+    QSettings* _system;
+
+    QHash<QString, QVariant> _defaults;
+
+    QHash<QString, QVariant> _session;
+
+    /**
+     * @brief The resolved view of all layers, filled on first access of a key
+     */
+    mutable QHash<QString, Resolved> _resolved;
+};
+
+#endif // SETTINGSSTORE_H
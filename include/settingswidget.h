@@ -25,6 +25,7 @@
 #include <QDialogButtonBox>
 #include <QSettings>
 #include "settingspanel.h"
+#include "settingscache.h"
 
 /**
  * @brief A widget to display and edit settings using several SettingsPanels.
@@ -36,10 +37,93 @@ class SettingsWidget : public QWidget
 
 public:
 
+    /**
+     * @brief Encoding of settings snapshots
+     */
+    enum SnapshotFormat : int8_t {Json, Cbor};
+
+    /**
+     * @brief Unit of the budget for the widgets of panels
+     */
+    enum BudgetUnit : int8_t {Items, Bytes};
+
+    /**
+     * @brief Result of a snapshot import
+     */
+    struct SnapshotReport
+    {
+        /**
+         * @brief Number of values that were written
+         */
+        int applied = 0;
+        /**
+         * @brief Keys that are not part of any panel
+         */
+        QStringList unknown;
+        /**
+         * @brief Keys whose values don't match the type of the setting
+         */
+        QStringList rejected;
+    };
+
     SettingsWidget(QSettings* settings, QWidget* parent = 0, QTabWidget::TabPosition position = QTabWidget::North);
 
     void setTabbarPosition(QTabWidget::TabPosition position);
 
+    /**
+     * @brief Construct the SettingItems of panels added with addJsonPanel progressively
+     *
+     * The first screenful of every panel is constructed right away, the rest in small time slices
+     * so the widget can be shown before all panels are complete.
+     *
+     * @param progressive whether to construct progressively
+     * @return void
+     */
+    void setProgressiveConstruction(bool progressive);
+
+    /**
+     * @brief Construct the SettingItems of panels added with addJsonPanel as SettingLiteItems
+     *
+     * Lite items paint their title and value instead of building labels, layouts and editors,
+     * the editor is only created when an item gets the focus or is clicked.
+     *
+     * @param lite whether to construct lite items
+     * @return void
+     */
+    void setLiteItems(bool lite);
+
+    /**
+     * @brief Watch the json files of panels added with addJsonPanel and update the panels when they change
+     *
+     * Included files are watched as well. Changed panels are updated in place, keeping unsaved
+     * changes and the scroll position, see SettingsPanel::updateFromJson. Meant for developing schemas.
+     *
+     * @param watch whether to watch the files
+     * @return void
+     */
+    void setSchemaWatching(bool watch);
+
+    /**
+     * @brief Limit the widgets kept alive for panels that are not shown
+     *
+     * When the constructed widgets of all panels exceed the budget, the widgets of the least
+     * recently shown panels are destroyed (see SettingsPanel::evictWidgets) and constructed
+     * again when the panel is shown. The shown panel is never evicted.
+     *
+     * @param budget the number of widgets or bytes (estimated) to keep, 0 to keep everything
+     * @param unit the unit of the budget
+     * @return void
+     */
+    void setEvictionBudget(qint64 budget, BudgetUnit unit = Items);
+
+    /**
+     * @brief Publish the values of all panels to a cache whenever the settings are saved
+     *
+     * @param cache the cache for other threads, may be nullptr
+     * @return void
+     */
+    void setCache(SettingsCache* cache);
+
     /**
      * @brief Add a SettingsPanel to the QTabWidget
      *
@@ -70,10 +154,133 @@ public:
      */
     void addJsonPanel(QString panelname, QJsonArray json, QIcon icon = QIcon());
 
+    /**
+     * @brief Export the user layer values of the settings in all panels that differ from their default
+     *
+     * @param format the encoding of the snapshot
+     * @return QByteArray a map of full keys ("section/key") to values
+     */
+    QByteArray exportSnapshot(SnapshotFormat format = Cbor) const;
+
+    /**
+     * @brief Import a snapshot created by exportSnapshot
+     *
+     * All values are checked against the type of their setting and written in a single batch,
+     * unsaved changes in the panels are discarded.
+     *
+     * @param data the encoded snapshot
+     * @param format the encoding of the snapshot
+     * @return SnapshotReport
+     */
+    SnapshotReport importSnapshot(const QByteArray& data, SnapshotFormat format = Cbor);
+
+    /**
+     * @brief Change settings of the panels as if the user edited them, without saving them
+     *
+     * @param values the new values by full key ("section/key")
+     * @return SnapshotReport the applied, unknown and rejected values
+     */
+    SnapshotReport applyValues(const QVariantHash& values);
+
+    /**
+     * @brief The saved value of a setting, the default if nothing is saved
+     *
+     * @param path the full key ("section/key")
+     * @return QVariant the stored value for keys that are not part of any panel, invalid if there is none
+     */
+    QVariant savedValue(const QString& path) const;
+
+    /**
+     * @brief Save all the settings in all SettingsPanels to disk
+     *
+     * @return void
+     */
+    void saveSettings();
+
+    /**
+     * @brief The names of all presets, defined in the json descriptions of the panels or saved by the user
+     *
+     * @return QStringList
+     */
+    QStringList presetNames() const;
+
+    /**
+     * @brief Apply a preset to all panels. The values are not saved until the settings are saved.
+     *
+     * @param name the name of the preset
+     * @return bool false if there is no preset with the name
+     */
+    bool applyPreset(const QString& name);
+
+    /**
+     * @brief Save the current values of all panels as a user preset
+     *
+     * User presets are stored in a settings file of their own next to the settings (e.g. app_presets.ini
+     * for app.ini), so they never show up among the values, and replace presets from the json
+     * descriptions with the same name.
+     *
+     * @param name the name of the preset
+     * @return void
+     */
+    void savePreset(const QString& name);
+
+    /**
+     * @brief Remove a user preset
+     *
+     * @param name the name of the preset
+     * @return void
+     */
+    void removePreset(const QString& name);
+
+signals:
+
+    /**
+     * @brief Progress of the progressive construction of a panel
+     *
+     * @param panel the panel being constructed
+     * @param done number of entries that have been processed
+     * @param total number of entries in the panel
+     */
+    void constructionProgress(SettingsPanel* panel, int done, int total);
+
 private:
 
     QSettings* _settings;
 
+    /**
+     * @brief The user presets, created on first use
+     */
+    mutable QSettings* _preset_settings = nullptr;
+
+    bool _progressive = false;
+
+    bool _lite = false;
+
+    SettingsCache* _cache = nullptr;
+
+    qint64 _eviction_budget = 0;
+
+    BudgetUnit _budget_unit = Items;
+
+    /**
+     * @brief All panels, the most recently shown first
+     */
+    QList<SettingsPanel*> _recent_panels;
+
+    /**
+     * @brief Schema file of each panel added from a file
+     */
+    QHash<SettingsPanel*, QString> _schema_files;
+
+    QFileSystemWatcher* _schema_watcher = nullptr;
+
+    /**
+     * @brief Collects the changes of a file that is written in several steps
+     */
+    QTimer* _schema_reload_timer = nullptr;
+
+    QSet<QString> _changed_schema_files;
+
     QTabWidget* _panel_container;
 
     QDialogButtonBox* _buttons;
@@ -86,11 +293,52 @@ private:
     void restoreDefaults();
 
     /**
-     * @brief Save all the settings in all SettingsPanels to disk
+     * @brief The settings holding the user presets
+     *
+     * @return QSettings* a file beside the one of the settings, in the same format
+     */
+    QSettings* presetSettings() const;
+
+    /**
+     * @brief Group values by the panel containing them, checked against the type of their setting
+     */
+    QHash<SettingsPanel*, QVariantHash> assignValues(const QVariantHash& values, SnapshotReport& report) const;
+
+    /**
+     * @brief Publish the stored values of all SettingsPanels to the cache
      *
      * @return void
      */
-    void saveSettings();
+    void publishCache();
+
+    /**
+     * @brief Move a panel to the front of the recently shown panels
+     *
+     * @param index the tab index of the panel
+     * @return void
+     */
+    void panelShown(int index);
+
+    /**
+     * @brief Evict the widgets of the least recently shown panels until the budget is met
+     *
+     * @return void
+     */
+    void applyEvictionBudget();
+
+    /**
+     * @brief Watch all schema files and their includes that are not watched yet
+     *
+     * @return void
+     */
+    void watchSchemaFiles();
+
+    /**
+     * @brief Update the panels whose schema files changed
+     *
+     * @return void
+     */
+    void reloadSchemas();
 
 private slots:
 
@@ -0,0 +1,238 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SETTINGTABLE_H
+#define SETTINGTABLE_H
+
+#include <QAbstractTableModel>
+#include <QSet>
+#include <QVector>
+
+#include "settingitems.h"
+
+
+/**
+ * @brief Table model holding the rows of a SettingTable and tracking which rows changed
+ *
+ */
+class SettingTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * @brief Description of a column
+     */
+    struct Column
+    {
+        enum Type : int8_t {String, Numeric, Bool};
+
+        QString title;
+        Type type;
+        double minimum;
+        double maximum;
+    };
+
+    SettingTableModel(QVector<Column> columns, QObject* parent = 0);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const;
+
+    int columnCount(const QModelIndex& parent = QModelIndex()) const;
+
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+
+    bool setData(const QModelIndex& index, const QVariant& value, int role = Qt::EditRole);
+
+    Qt::ItemFlags flags(const QModelIndex& index) const;
+
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+
+    bool insertRows(int row, int count, const QModelIndex& parent = QModelIndex());
+
+    bool removeRows(int row, int count, const QModelIndex& parent = QModelIndex());
+
+    /**
+     * @brief Replace all rows
+     *
+     * @param rows the new rows, each with one value per column
+     * @param stored_rows the number of rows that are currently stored
+     * @param dirty whether the new rows differ from the stored rows
+     * @return void
+     */
+    void setRows(QVector<QVariantList> rows, int stored_rows, bool dirty);
+
+    const QVector<QVariantList>& rows() const;
+
+    /**
+     * @brief The rows that changed since the last call of markClean
+     *
+     * @return QVector<int>
+     */
+    QVector<int> dirtyRows() const;
+
+    /**
+     * @brief The number of rows in the storage
+     *
+     * @return int
+     */
+    int storedRowCount() const;
+
+    /**
+     * @brief Mark all rows as stored
+     *
+     * @return void
+     */
+    void markClean();
+
+    /**
+     * @brief Check a cell value against the column type and convert it
+     *
+     * @return bool false if the value is not valid for the column
+     */
+    static bool convertCell(const Column& column, QVariant& value);
+
+private:
+
+    QVector<Column> _columns;
+
+    QVector<QVariantList> _rows;
+
+    /**
+     * @brief Edited rows below _dirty_from
+     */
+    QSet<int> _dirty_rows;
+
+    /**
+     * @brief All rows from this index on changed, e.g. because rows were inserted or removed
+     */
+    int _dirty_from;
+
+    int _stored_rows;
+
+    void markDirtyFrom(int row);
+
+    QVariantList defaultRow() const;
+};
+
+
+/**
+ * @brief SettingItem for typed lists ("list") and tables ("table") edited through a QTableView
+ *
+ * The rows are stored as "section/key/size" and "section/key/<row>" (starting with 1), so only
+ * changed rows have to be written back. Table rows are stored as lists with one value per column.
+ */
+class SettingTable : public SettingItem
+{
+    Q_OBJECT
+
+public:
+
+    SettingTable(QSettings* settings, QString title, QString section, QString key,
+                 QVector<SettingTableModel::Column> columns, bool single_column, QVariantList default_value,
+                 QString desc = "", QWidget* parent = 0);
+
+    static SettingItem* fromJsonObject(QJsonObject obj, QSettings* settings, QWidget* parent = 0);
+
+    /**
+     * @brief Check a value against the json description and convert it to the setting's type
+     *
+     * @param obj the json object describing the setting
+     * @param value the value to check, converted in place
+     * @return bool false if the value is not valid for the setting
+     */
+    static bool convertValue(const QJsonObject& obj, QVariant& value);
+
+    /**
+     * @brief Read all stored rows
+     *
+     * @return QVariant a QVariantList of rows or an invalid QVariant if nothing is stored
+     */
+    static QVariant readRows(QSettings* settings, const QString& section, const QString& key);
+
+    /**
+     * @brief Replace all stored rows
+     *
+     * @return void
+     */
+    static void writeRows(QSettings* settings, const QString& section, const QString& key, const QVariant& value);
+
+    /**
+     * @brief Restore the default value
+     *
+     * @return void
+     */
+    void restoreDefault();
+
+    /**
+     * @brief Save the setting. Only rows that changed are written.
+     *
+     * @return void
+     */
+    void saveSetting();
+
+    QVariant value() const;
+
+    QVariant defaultValue() const;
+
+    void setValue(const QVariant& value);
+
+protected:
+
+    /**
+     * @brief Load the setting
+     *
+     * @return void
+     */
+    void loadSetting();
+
+private:
+
+    QTableView* _view;
+
+    SettingTableModel* _model;
+
+    /**
+     * @brief A list with plain values instead of a table with one list per row
+     */
+    bool _single_column;
+
+    QVariantList _default_value;
+
+    QVector<SettingTableModel::Column> _columns;
+
+    static QVector<SettingTableModel::Column> parseColumns(const QJsonObject& obj);
+
+    /**
+     * @brief Check a list of rows against the columns and convert it
+     */
+    static bool convertRows(const QVector<SettingTableModel::Column>& columns, bool single_column, QVariant& value);
+
+    /**
+     * @brief Convert the value of the setting to one list per row
+     */
+    QVector<QVariantList> toRows(const QVariantList& value) const;
+
+    void addRow();
+
+    void removeSelectedRows();
+};
+
+#endif // SETTINGTABLE_H
@@ -0,0 +1,106 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SETTINGVALIDATOR_H
+#define SETTINGVALIDATOR_H
+
+#include <atomic>
+#include <functional>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QString>
+
+
+/**
+ * @brief Constraints for text values, compiled from a json description
+ *
+ * Supported fields are "pattern" (a regular expression the whole text has to match),
+ * "min_length", "max_length", "minimum" and "maximum" (the text has to be a number in the range)
+ * and "validator" (the name of a registered asynchronous validator).
+ * Regular expressions are compiled once and shared by all validators using the same pattern.
+ */
+class SettingValidator
+{
+public:
+
+    /**
+     * @brief An expensive check that runs off the GUI thread
+     *
+     * Receives the text and a flag that is set once the result is no longer needed,
+     * returns an error message or an empty string if the text is valid.
+     */
+    typedef std::function<QString(const QString&, const std::atomic<bool>&)> AsyncValidator;
+
+    /**
+     * @brief Creates a validator that accepts everything
+     */
+    SettingValidator();
+
+    static SettingValidator fromJsonObject(const QJsonObject& obj);
+
+    /**
+     * @brief Register an asynchronous validator that can be referenced with the "validator" field
+     *
+     * @param name the name used in the json description
+     * @param validator the validation function, called from a worker thread
+     * @return void
+     */
+    static void registerAsyncValidator(QString name, AsyncValidator validator);
+
+    /**
+     * @brief Whether the validator has no constraints at all
+     *
+     * @return bool
+     */
+    bool isNull() const;
+
+    /**
+     * @brief Check the fast constraints
+     *
+     * @param text the text to check
+     * @return QString an error message or an empty string if the text is valid
+     */
+    QString validate(const QString& text) const;
+
+    /**
+     * @brief The asynchronous validator or an empty function if there is none
+     *
+     * @return AsyncValidator
+     */
+    AsyncValidator asyncValidator() const;
+
+private:
+
+    QRegularExpression _pattern;
+
+    int _min_length;
+
+    int _max_length;
+
+    bool _numeric;
+
+    double _minimum;
+
+    double _maximum;
+
+    AsyncValidator _async_validator;
+};
+
+#endif // SETTINGVALIDATOR_H
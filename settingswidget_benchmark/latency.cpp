@@ -0,0 +1,193 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <QApplication>
+#include <QDialogButtonBox>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QTemporaryDir>
+#include <QTest>
+#include "settingswidget.h"
+#include "syntheticschema.h"
+
+/**
+ * Measures how quickly the widgets respond to user interactions on the offscreen platform and
+ * fails if a percentile exceeds its budget.
+ *
+ * Usage: settingswidget_latency [budgets.json]
+ */
+
+namespace
+{
+    /**
+     * @brief Notices when a widget or one of its children is painted
+     */
+    class PaintProbe : public QObject
+    {
+    public:
+
+        bool painted = false;
+
+        bool eventFilter(QObject* watched, QEvent* event)
+        {
+            if (event->type() == QEvent::Paint)
+            {
+                painted = true;
+            }
+            return QObject::eventFilter(watched, event);
+        }
+    };
+
+    /**
+     * @brief Run an interaction and return the time until widget was repainted in milliseconds
+     */
+    double measure(QWidget* widget, std::function<void()> interaction)
+    {
+        PaintProbe probe;
+        widget->installEventFilter(&probe);
+        for (QWidget* child: widget->findChildren<QWidget*>())
+        {
+            child->installEventFilter(&probe);
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        interaction();
+        while (!probe.painted and timer.elapsed() < 1000)
+        {
+            QApplication::processEvents();
+        }
+        double elapsed = timer.nsecsElapsed() / 1e6;
+        QApplication::processEvents();
+        return elapsed;
+    }
+
+    double percentile(std::vector<double> samples, double p)
+    {
+        if (samples.empty())
+        {
+            return 0;
+        }
+        std::sort(samples.begin(), samples.end());
+        int idx = int(std::ceil(p * samples.size())) - 1;
+        return samples[std::max(0, std::min(idx, int(samples.size()) - 1))];
+    }
+
+    template<typename T>
+    T* findInItem(SettingsPanel* panel, const char* item_class)
+    {
+        for (SettingItem* item: panel->findChildren<SettingItem*>())
+        {
+            if (item->inherits(item_class))
+            {
+                return item->findChild<T*>();
+            }
+        }
+        return nullptr;
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+
+    QString budgets_file = app.arguments().value(1, SETTINGSWIDGET_LATENCY_BUDGETS);
+    QFile file(budgets_file);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        std::cerr << "Couldn't open " << budgets_file.toStdString() << std::endl;
+        return 2;
+    }
+    QJsonObject config = QJsonDocument::fromJson(file.readAll()).object();
+    QJsonObject budgets = config.value("budgets").toObject();
+    int iterations = config.value("iterations").toInt(100);
+
+    QTemporaryDir directory;
+    QSettings settings(directory.filePath("latency.ini"), QSettings::IniFormat);
+    SettingsStore store(&settings);
+    QStringList types = {"bool", "string", "path", "numeric", "options"};
+
+    bool failed = false;
+    for (const QJsonValue& size_value: config.value("sizes").toArray())
+    {
+        int size = size_value.toInt();
+        SettingsWidget widget(&settings);
+        widget.addJsonPanel("first", syntheticSchema(size, types));
+        widget.addJsonPanel("second", syntheticSchema(size, types));
+        widget.resize(800, 600);
+        widget.show();
+        QTest::qWaitForWindowExposed(&widget);
+
+        QTabWidget* tabs = widget.findChild<QTabWidget*>();
+        SettingsPanel* panel = (SettingsPanel*)tabs->widget(0);
+        QLineEdit* line_edit = findInItem<QLineEdit>(panel, "SettingString");
+        QDoubleSpinBox* spinbox = findInItem<QDoubleSpinBox>(panel, "SettingNumeric");
+        QComboBox* combobox = findInItem<QComboBox>(panel, "SettingOptions");
+        QPushButton* apply = widget.findChild<QDialogButtonBox*>()->button(QDialogButtonBox::Apply);
+
+        QMap<QString, std::vector<double>> samples;
+        for (int i=0; i<iterations; ++i)
+        {
+            samples["string_keystroke"].push_back(measure(line_edit, [line_edit]() {
+                QTest::keyClick(line_edit, Qt::Key_A);
+            }));
+            samples["numeric_step"].push_back(measure(spinbox, [spinbox, i]() {
+                QTest::keyClick(spinbox, i % 2 ? Qt::Key_Down : Qt::Key_Up);
+            }));
+            samples["options_open"].push_back(measure(combobox->view(), [combobox]() {
+                combobox->showPopup();
+            }));
+            combobox->hidePopup();
+            samples["tab_switch"].push_back(measure(tabs, [tabs]() {
+                tabs->setCurrentIndex(1 - tabs->currentIndex());
+            }));
+            tabs->setCurrentIndex(0);
+            samples["apply"].push_back(measure(&widget, [apply]() {
+                QTest::mouseClick(apply, Qt::LeftButton);
+            }));
+            // keep the line edit short
+            line_edit->clear();
+        }
+
+        std::cout << "Size " << size << std::endl;
+        for (auto it = samples.begin(); it != samples.end(); ++it)
+        {
+            double p50 = percentile(it.value(), 0.5);
+            double p99 = percentile(it.value(), 0.99);
+            QJsonObject budget = budgets.value(it.key()).toObject();
+            bool over_budget = (budget.contains("p50") and p50 > budget.value("p50").toDouble())
+                or (budget.contains("p99") and p99 > budget.value("p99").toDouble());
+            failed = failed or over_budget;
+            std::cout << "    " << it.key().toStdString() << ": p50 " << p50 << " ms, p99 " << p99 << " ms"
+                      << (over_budget ? "  OVER BUDGET" : "") << std::endl;
+        }
+    }
+    return failed ? 1 : 0;
+}
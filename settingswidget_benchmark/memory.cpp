@@ -0,0 +1,375 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <QApplication>
+#include <QFile>
+#include <QJsonDocument>
+#include <QTemporaryDir>
+#include <QTest>
+#include "settingspanel.h"
+#include "syntheticschema.h"
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+/**
+ * Measures the heap memory, allocations and QObjects of panels per item type and how they grow with
+ * the size of the schema, on the offscreen platform. Fails if a result exceeds its baseline by more
+ * than the tolerance. Types without a baseline, lite items and mixed schemas are only reported.
+ * With glibc all heap memory is counted, elsewhere only memory allocated with operator new.
+ *
+ * Usage: settingswidget_memory [baseline.json] [--update-baseline]
+ */
+
+namespace
+{
+    std::atomic<long long> _live_bytes(0);
+    std::atomic<long long> _allocations(0);
+}
+
+#ifdef __GLIBC__
+#include <malloc.h>
+
+// Qt containers (QArrayData, QHashData) allocate with malloc, so the malloc family is replaced and
+// operator new, which calls malloc, is counted as well. glibc exports its own implementations.
+extern "C"
+{
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* ptr, size_t size);
+    void* __libc_memalign(size_t alignment, size_t size);
+    void __libc_free(void* ptr);
+}
+
+namespace
+{
+    void* counted(void* ptr)
+    {
+        if (ptr)
+        {
+            _live_bytes += malloc_usable_size(ptr);
+            ++_allocations;
+        }
+        return ptr;
+    }
+}
+
+extern "C"
+{
+    void* malloc(size_t size) noexcept
+    {
+        return counted(__libc_malloc(size));
+    }
+
+    void* calloc(size_t count, size_t size) noexcept
+    {
+        return counted(__libc_calloc(count, size));
+    }
+
+    void* realloc(void* ptr, size_t size) noexcept
+    {
+        long long previous = ptr ? malloc_usable_size(ptr) : 0;
+        void* result = __libc_realloc(ptr, size);
+        if (result)
+        {
+            _live_bytes += (long long)malloc_usable_size(result) - previous;
+            ++_allocations;
+        }
+        else if (size == 0)
+        {
+            // freed
+            _live_bytes -= previous;
+        }
+        return result;
+    }
+
+    void* memalign(size_t alignment, size_t size) noexcept
+    {
+        return counted(__libc_memalign(alignment, size));
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size) noexcept
+    {
+        return counted(__libc_memalign(alignment, size));
+    }
+
+    int posix_memalign(void** ptr, size_t alignment, size_t size) noexcept
+    {
+        void* result = __libc_memalign(alignment, size);
+        if (!result)
+        {
+            return ENOMEM;
+        }
+        *ptr = counted(result);
+        return 0;
+    }
+
+    void free(void* ptr) noexcept
+    {
+        if (ptr)
+        {
+            _live_bytes -= malloc_usable_size(ptr);
+            __libc_free(ptr);
+        }
+    }
+}
+#else
+namespace
+{
+    /**
+     * @brief Room in front of each allocation for its size, keeps the alignment of malloc
+     */
+    const size_t _header = 16;
+
+    void* allocate(size_t size)
+    {
+        void* block = std::malloc(size + _header);
+        if (!block)
+        {
+            return nullptr;
+        }
+        *static_cast<size_t*>(block) = size;
+        _live_bytes += size;
+        ++_allocations;
+        return static_cast<char*>(block) + _header;
+    }
+
+    void release(void* ptr)
+    {
+        if (!ptr)
+        {
+            return;
+        }
+        void* block = static_cast<char*>(ptr) - _header;
+        _live_bytes -= *static_cast<size_t*>(block);
+        std::free(block);
+    }
+}
+
+// without glibc only operator new is counted, memory Qt containers allocate with malloc is missing
+void* operator new(size_t size)
+{
+    void* ptr = allocate(size);
+    if (!ptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    release(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    release(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    release(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    release(ptr);
+}
+#endif
+
+namespace
+{
+    struct Footprint
+    {
+        double bytes = 0;
+        double allocations = 0;
+        double qobjects = 0;
+        double resident = 0;
+    };
+
+    /**
+     * @brief Resident memory of the process in bytes, 0 where it can't be determined
+     */
+    long long residentMemory()
+    {
+#ifdef Q_OS_LINUX
+        QFile statm("/proc/self/statm");
+        if (statm.open(QIODevice::ReadOnly))
+        {
+            QList<QByteArray> fields = statm.readAll().split(' ');
+            if (fields.size() > 1)
+            {
+                return fields[1].toLongLong() * sysconf(_SC_PAGESIZE);
+            }
+        }
+#endif
+        return 0;
+    }
+
+    /**
+     * @brief The memory of a shown panel built from a schema, per item
+     */
+    Footprint measure(const QJsonArray& schema, QSettings* settings, bool lite = false)
+    {
+        // settle caches of Qt (fonts, styles) with a small panel first
+        delete SettingsPanel::fromJson(syntheticSchema(5, QStringList() << "bool"), settings);
+        QApplication::processEvents();
+
+        long long bytes = _live_bytes;
+        long long allocations = _allocations;
+        long long resident = residentMemory();
+
+        SettingsPanel* panel = SettingsPanel::fromJson(schema, settings, nullptr, false, lite);
+        panel->resize(800, 600);
+        panel->show();
+        QTest::qWaitForWindowExposed(panel);
+        QApplication::processEvents();
+
+        Footprint footprint;
+        double count = schema.size();
+        footprint.bytes = (_live_bytes - bytes) / count;
+        footprint.allocations = (_allocations - allocations) / count;
+        footprint.qobjects = (panel->findChildren<QObject*>().size() + 1) / count;
+        footprint.resident = (residentMemory() - resident) / count;
+        delete panel;
+        QApplication::processEvents();
+        return footprint;
+    }
+
+    void print(const QString& name, const Footprint& footprint)
+    {
+        std::cout << "    " << name.toStdString() << ": " << footprint.bytes << " bytes, "
+                  << footprint.allocations << " allocations, " << footprint.qobjects << " QObjects, "
+                  << footprint.resident << " resident bytes per item" << std::endl;
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+
+    QStringList arguments = app.arguments();
+    bool update_baseline = arguments.removeAll("--update-baseline") > 0;
+    QString baseline_file = arguments.value(1, SETTINGSWIDGET_MEMORY_BASELINE);
+    QFile file(baseline_file);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        std::cerr << "Couldn't open " << baseline_file.toStdString() << std::endl;
+        return 2;
+    }
+    QJsonObject baseline = QJsonDocument::fromJson(file.readAll()).object();
+    file.close();
+    int items = baseline.value("items").toInt(1000);
+    double tolerance = baseline.value("tolerance").toDouble(0.1);
+    QJsonObject expected = baseline.value("types").toObject();
+
+    QTemporaryDir directory;
+    QSettings settings(directory.filePath("memory.ini"), QSettings::IniFormat);
+    SettingsStore store(&settings);
+    QStringList types = {"bool", "string", "path", "numeric", "options"};
+
+    bool failed = false;
+    QJsonObject measured;
+    std::cout << "Per type, " << items << " items" << std::endl;
+    for (const QString& type: types)
+    {
+        Footprint footprint = measure(syntheticSchema(items, QStringList() << type), &settings);
+        print(type, footprint);
+        measured.insert(type, QJsonObject{{"bytes", footprint.bytes}, {"allocations", footprint.allocations},
+                                          {"qobjects", footprint.qobjects}});
+
+        // resident memory depends on the allocator and is only reported
+        QJsonObject limits = expected.value(type).toObject();
+        if (limits.isEmpty() and !update_baseline)
+        {
+            // the numbers depend on the Qt build and platform, a missing baseline is no regression
+            std::cout << "        no baseline, record one with --update-baseline" << std::endl;
+        }
+        for (const QString& metric: QStringList{"bytes", "allocations", "qobjects"})
+        {
+            if (!limits.contains(metric))
+            {
+                continue;
+            }
+            double value = measured.value(type).toObject().value(metric).toDouble();
+            double limit = limits.value(metric).toDouble() * (1 + tolerance);
+            if (value > limit)
+            {
+                std::cout << "        " << metric.toStdString() << " exceeds the baseline of "
+                          << limits.value(metric).toDouble() << std::endl;
+                failed = true;
+            }
+        }
+    }
+
+    // lite items are only reported, they are meant to stay well below the real items
+    std::cout << "Per type as lite items, " << items << " items" << std::endl;
+    for (const QString& type: types)
+    {
+        print(type, measure(syntheticSchema(items, QStringList() << type), &settings, true));
+    }
+
+    std::cout << "Mixed types" << std::endl;
+    for (const QJsonValue& size: baseline.value("sizes").toArray())
+    {
+        print(QString("%1 items").arg(size.toInt()), measure(syntheticSchema(size.toInt(), types), &settings));
+    }
+
+    if (update_baseline)
+    {
+        baseline.insert("types", measured);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            std::cerr << "Couldn't write " << baseline_file.toStdString() << std::endl;
+            return 2;
+        }
+        file.write(QJsonDocument(baseline).toJson());
+        std::cout << "Baseline updated" << std::endl;
+        return 0;
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,71 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SYNTHETICSCHEMA_H
+#define SYNTHETICSCHEMA_H
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QStringList>
+
+
+/**
+ * @brief Build a schema with count settings of the given types, spread over sections of 50 settings
+ *
+ * @param count the number of settings
+ * @param types the types to cycle through
+ * @return QJsonArray
+ */
+inline QJsonArray syntheticSchema(int count, const QStringList& types)
+{
+    QJsonArray schema;
+    for (int i=0; i<count; ++i)
+    {
+        QString type = types[i % types.size()];
+        QJsonObject obj;
+        obj.insert("type", type);
+        obj.insert("title", QString("%1 %2").arg(type).arg(i));
+        obj.insert("desc", QString("synthetic %1 setting").arg(type));
+        obj.insert("section", QString("section%1").arg(i / 50));
+        obj.insert("key", QString("key%1").arg(i));
+        if (type == "bool")
+        {
+            obj.insert("default", i % 2 == 0);
+        }
+        else if (type == "string" or type == "path")
+        {
+            obj.insert("default", QString("value %1").arg(i));
+        }
+        else if (type == "numeric")
+        {
+            obj.insert("default", i % 100);
+            obj.insert("decimals", 0);
+        }
+        else if (type == "options")
+        {
+            obj.insert("options", QJsonObject{{"one", 1}, {"two", 2}, {"three", 3}});
+            obj.insert("default", 1 + i % 3);
+        }
+        schema.append(obj);
+    }
+    return schema;
+}
+
+#endif // SYNTHETICSCHEMA_H
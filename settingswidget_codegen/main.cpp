@@ -0,0 +1,430 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <iostream>
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QList>
+#include <QMap>
+#include <QSet>
+#include <QStringList>
+#include <QTextStream>
+#include "settingsschema.h"
+
+/**
+ * Generates a C++ header from a json schema. The header contains the schema as a QJsonArray that is
+ * built from initializer lists instead of being parsed and one struct per setting for the typed
+ * accessors in settingsaccessors.h.
+ *
+ * Usage: settingswidget_codegen <schema.json> <output.h> <namespace> [<depfile> <depfile target>]
+ *
+ * The optional depfile lists the schema and all files it includes as prerequisites of the depfile target
+ * in make syntax, so build systems regenerate the header when an included file changes.
+ */
+
+namespace
+{
+    const QSet<QString> _keywords = {
+        "and", "auto", "bool", "break", "case", "catch", "char", "class", "const", "continue", "default",
+        "delete", "do", "double", "else", "enum", "explicit", "export", "extern", "false", "float", "for",
+        "friend", "goto", "if", "inline", "int", "long", "namespace", "new", "not", "operator", "or",
+        "private", "protected", "public", "register", "return", "short", "signed", "sizeof", "static",
+        "struct", "switch", "template", "this", "throw", "true", "try", "typedef", "union", "unsigned",
+        "using", "virtual", "void", "volatile", "while"
+    };
+
+    QString identifier(const QString& name)
+    {
+        QString result;
+        for (QChar c: name)
+        {
+            result += (c.isLetterOrNumber() and c.unicode() < 128) ? c : QChar('_');
+        }
+        if (result.isEmpty() or result[0].isDigit() or _keywords.contains(result))
+        {
+            result += '_';
+        }
+        return result;
+    }
+
+    QString stringLiteral(const QString& text)
+    {
+        // \u escapes keep the literal correct independent of the source charset
+        QString result = "QStringLiteral(\"";
+        for (uint code: text.toUcs4())
+        {
+            if (code == '"' or code == '\\')
+            {
+                result += '\\';
+                result += QChar(code);
+            }
+            else if (code == '\n')
+            {
+                result += "\\n";
+            }
+            else if (code == '\t')
+            {
+                result += "\\t";
+            }
+            else if (code >= 0x20 and code < 0x7f)
+            {
+                result += QChar(code);
+            }
+            else if (code < 0x10000)
+            {
+                result += QString("\\u%1").arg(code, 4, 16, QChar('0'));
+            }
+            else
+            {
+                result += QString("\\U%1").arg(code, 8, 16, QChar('0'));
+            }
+        }
+        return result + "\")";
+    }
+
+    QString narrowLiteral(const QString& text)
+    {
+        QString result = "\"";
+        for (char c: text.toUtf8())
+        {
+            if (c == '"' or c == '\\')
+            {
+                result += '\\';
+                result += c;
+            }
+            else if (c >= 0x20 and c < 0x7f)
+            {
+                result += c;
+            }
+            else
+            {
+                result += QString("\\%1").arg(uint(uchar(c)), 3, 8, QChar('0'));
+            }
+        }
+        return result + "\"";
+    }
+
+    QString valueCode(const QJsonValue& value, const QString& indent);
+
+    QString objectCode(const QJsonObject& obj, const QString& indent)
+    {
+        QStringList members;
+        for (auto it = obj.begin(); it != obj.end(); ++it)
+        {
+            members << indent + "    {" + stringLiteral(it.key()) + ", " + valueCode(it.value(), indent + "    ") + "}";
+        }
+        if (members.isEmpty())
+        {
+            return "QJsonObject()";
+        }
+        return "QJsonObject{\n" + members.join(",\n") + "\n" + indent + "}";
+    }
+
+    QString valueCode(const QJsonValue& value, const QString& indent)
+    {
+        switch (value.type())
+        {
+            case QJsonValue::Bool:
+                return value.toBool() ? "true" : "false";
+            case QJsonValue::Double:
+            {
+                double number = value.toDouble();
+                if (qAbs(number) < 2147483648.0 and number == qint64(number))
+                {
+                    return QString::number(qint64(number));
+                }
+                return QString::number(number, 'g', 17);
+            }
+            case QJsonValue::String:
+                return stringLiteral(value.toString());
+            case QJsonValue::Array:
+            {
+                QStringList items;
+                for (const QJsonValue& item: value.toArray())
+                {
+                    items << indent + "    " + valueCode(item, indent + "    ");
+                }
+                if (items.isEmpty())
+                {
+                    return "QJsonArray()";
+                }
+                return "QJsonArray{\n" + items.join(",\n") + "\n" + indent + "}";
+            }
+            case QJsonValue::Object:
+                return objectCode(value.toObject(), indent);
+            default:
+                return "QJsonValue()";
+        }
+    }
+
+    /**
+     * @brief The C++ type of the value of a setting
+     */
+    QString valueType(const QString& type)
+    {
+        static const QMap<QString, QString> types = {
+            {"bool", "bool"},
+            {"string", "QString"},
+            {"path", "QString"},
+            {"numeric", "double"},
+            {"list", "QVariantList"},
+            {"table", "QVariantList"}
+        };
+        return types.value(type, "QVariant");
+    }
+
+    /**
+     * @brief Escape a path for a make rule
+     */
+    QString depfilePath(const QString& path)
+    {
+        QString escaped = path;
+        escaped.replace("$", "$$");
+        escaped.replace(" ", "\\ ");
+        escaped.replace("#", "\\#");
+        return escaped;
+    }
+
+    bool writeDepfile(const QString& filename, const QString& target, const QStringList& dependencies)
+    {
+        QString rule = depfilePath(QFileInfo(target).absoluteFilePath()) + ":";
+        for (const QString& dependency: dependencies)
+        {
+            rule += " \\\n  " + depfilePath(dependency);
+        }
+        QFile depfile(filename);
+        if (!depfile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            return false;
+        }
+        depfile.write((rule + "\n").toUtf8());
+        return true;
+    }
+
+    struct Setting
+    {
+        QJsonObject obj;
+        /**
+         * @brief Expression for the json object of the setting in the generated schema()
+         */
+        QString access;
+    };
+
+    /**
+     * @brief Collect the entries of the schema in display order, descending into groups
+     */
+    void collectSettings(const QJsonArray& entries, const QString& access, QList<Setting>& settings)
+    {
+        for (int i=0; i<entries.size(); ++i)
+        {
+            Setting setting;
+            setting.obj = entries[i].toObject();
+            setting.access = QString("%1[%2].toObject()").arg(access).arg(i);
+            settings << setting;
+            if (setting.obj.value("type").toString() == "group")
+            {
+                collectSettings(setting.obj.value("children").toArray(), setting.access + ".value(\"children\").toArray()",
+                                settings);
+            }
+        }
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList arguments = app.arguments();
+    if (arguments.size() != 4 and arguments.size() != 6)
+    {
+        std::cerr << "Usage: settingswidget_codegen <schema.json> <output.h> <namespace> [<depfile> <depfile target>]"
+                  << std::endl;
+        return 1;
+    }
+
+    bool ok;
+    QJsonArray entries = SettingsSchema::load(arguments[1], &ok);
+    if (!ok)
+    {
+        std::cerr << "Could not load " << arguments[1].toStdString() << std::endl;
+        return 1;
+    }
+
+    QString ns = identifier(arguments[3]);
+    QString guard = ns.toUpper() + "_" + identifier(QFileInfo(arguments[2]).fileName()).toUpper();
+    QString code;
+    QTextStream out(&code);
+    out << "// Generated by settingswidget_codegen from " << QFileInfo(arguments[1]).fileName()
+        << " - do not edit\n\n"
+        << "#ifndef " << guard << "\n"
+        << "#define " << guard << "\n\n"
+        << "#include <QJsonArray>\n"
+        << "#include <QJsonObject>\n"
+        << "#include \"settingsaccessors.h\"\n\n"
+        << "namespace " << ns << "\n{\n";
+
+    QStringList objects;
+    for (const QJsonValue& entry: entries)
+    {
+        objects << "            " + valueCode(entry, "            ");
+    }
+    out << "    /**\n"
+        << "     * @brief The schema, usable with SettingsPanel::fromJson\n"
+        << "     */\n"
+        << "    inline const QJsonArray& schema()\n"
+        << "    {\n"
+        << "        static const QJsonArray schema = {\n"
+        << objects.join(",\n") << "\n"
+        << "        };\n"
+        << "        return schema;\n"
+        << "    }\n";
+
+    // group the settings by section, nested sections become nested namespaces
+    QMap<QString, QStringList> sections;
+    // the settings and sections by the C++ name they are generated as, to detect names that collide after sanitizing
+    QMap<QString, QString> structs = {{"schema", "schema() function"}};
+    QMap<QString, QString> namespaces;
+    bool collisions = false;
+    QList<Setting> settings;
+    collectSettings(entries, "schema()", settings);
+    for (const Setting& setting: settings)
+    {
+        const QJsonObject& obj = setting.obj;
+        QString type = obj.value("type").toString();
+        if (type == "title" or type == "group" or !obj.contains("key"))
+        {
+            continue;
+        }
+        QString section = obj.value("section").toString();
+        QString key = obj.value("key").toString();
+        QString name = identifier(key);
+        QString description = "setting " + (section.isEmpty() ? key : section + "/" + key);
+
+        QStringList parts;
+        for (const QString& part: section.split('/'))
+        {
+            if (!part.isEmpty())
+            {
+                parts << identifier(part);
+                namespaces.insert(parts.join("::"), "section " + section);
+            }
+        }
+        QString qualified_name = (QStringList(parts) << name).join("::");
+        if (structs.contains(qualified_name))
+        {
+            std::cerr << "The " << description.toStdString() << " and the " << structs[qualified_name].toStdString()
+                      << " both generate " << ns.toStdString() << "::" << qualified_name.toStdString() << std::endl;
+            collisions = true;
+            continue;
+        }
+        structs.insert(qualified_name, description);
+
+        QString item;
+        QTextStream item_out(&item);
+        item_out << "struct " << name << "\n"
+                 << "{\n"
+                 << "    typedef " << valueType(type) << " Type;\n"
+                 << "    static constexpr const char* section() { return " << narrowLiteral(section) << "; }\n"
+                 << "    static constexpr const char* key() { return " << narrowLiteral(key) << "; }\n"
+                 << "    static const QJsonObject& json()\n"
+                 << "    {\n"
+                 << "        static const QJsonObject json = " << setting.access << ";\n"
+                 << "        return json;\n"
+                 << "    }\n"
+                 << "};\n";
+        sections[section] << item;
+    }
+
+    for (auto it = structs.constBegin(); it != structs.constEnd(); ++it)
+    {
+        if (namespaces.contains(it.key()))
+        {
+            std::cerr << "The " << it.value().toStdString() << " and the " << namespaces[it.key()].toStdString()
+                      << " both generate " << ns.toStdString() << "::" << it.key().toStdString() << std::endl;
+            collisions = true;
+        }
+    }
+    if (collisions)
+    {
+        return 1;
+    }
+
+    for (auto it = sections.begin(); it != sections.end(); ++it)
+    {
+        QStringList parts;
+        for (const QString& part: it.key().split('/'))
+        {
+            if (!part.isEmpty())
+            {
+                parts << identifier(part);
+            }
+        }
+        QString indent = "    ";
+        out << "\n";
+        for (const QString& part: parts)
+        {
+            out << indent << "namespace " << part << "\n" << indent << "{\n";
+            indent += "    ";
+        }
+        for (const QString& item: it.value())
+        {
+            for (const QString& line: item.split('\n'))
+            {
+                if (!line.isEmpty())
+                {
+                    out << indent << line << "\n";
+                }
+            }
+        }
+        for (int i=0; i<parts.size(); ++i)
+        {
+            indent.chop(4);
+            out << indent << "}\n";
+        }
+    }
+
+    out << "}\n\n"
+        << "#endif // " << guard << "\n";
+    out.flush();
+
+    if (arguments.size() == 6 and !writeDepfile(arguments[4], arguments[5], SettingsSchema::includedFiles(arguments[1])))
+    {
+        std::cerr << "Could not write " << arguments[4].toStdString() << std::endl;
+        return 1;
+    }
+
+    // don't touch an unchanged header, so dependent sources are not rebuilt
+    QFile output(arguments[2]);
+    if (output.open(QIODevice::ReadOnly) and output.readAll() == code.toUtf8())
+    {
+        return 0;
+    }
+    output.close();
+    if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        std::cerr << "Could not write " << arguments[2].toStdString() << std::endl;
+        return 1;
+    }
+    output.write(code.toUtf8());
+    return 0;
+}
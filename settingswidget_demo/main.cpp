@@ -21,6 +21,8 @@
 #include <QApplication>
 #include <QSettings>
 #include "settingswidget.h"
+#include "settingssnapshot.h"
+#include "example_settings.h"
 #include <iostream>
 
 int main(int argc, char *argv[])
@@ -29,6 +31,23 @@ int main(int argc, char *argv[])
 
     auto settings = new QSettings(QSettings::IniFormat, QSettings::UserScope,
                                   "settingswidget_demo", "settingswidget_demo");
+    // layered lookup: session overrides (--set section/key=value) > user > system > defaults
+    auto system_settings = new QSettings(QSettings::IniFormat, QSettings::SystemScope,
+                                         "settingswidget_demo", "settingswidget_demo");
+    SettingsStore store(settings, system_settings);
+    store.parseArguments(a.arguments());
+    // other processes can read the saved values with SettingsSnapshotReader("settingswidget_demo")
+    SettingsSnapshotPublisher publisher("settingswidget_demo", &store);
+
+    // options of "provider": "directory" are the files in a directory, listed when the combobox is opened
+    SettingOptions::registerProvider("directory", [](const QJsonObject& args) {
+        QVariantMap options;
+        for (const QString& name: QDir(args.value("path").toString()).entryList(QDir::Files))
+        {
+            options.insert(name, name);
+        }
+        return options;
+    });
 
     SettingsWidget wid(settings, 0, QTabWidget::West);
     SettingsPanel* panel = new SettingsPanel(settings, &wid);
@@ -51,9 +70,19 @@ int main(int argc, char *argv[])
     panel->addSettingItem(set_option);
     wid.addPanel("Testpanel", panel, QIcon::fromTheme("document-new"));
 
-    // from json
-    // better use an absolute file path
-    wid.addJsonPanel("Json panel", "../../settingswidget_demo/example.json");
+    // --lite paints the items of json panels and creates their editors on demand
+    wid.setLiteItems(a.arguments().contains("--lite"));
+    // from json, compiled into the demo by settingswidget_generate_accessors
+    wid.addJsonPanel("Json panel", example::schema());
+    // --schema <file> adds a panel that is updated whenever the file is edited
+    int schema_arg = a.arguments().indexOf("--schema");
+    if (schema_arg > 0 and schema_arg + 1 < a.arguments().size())
+    {
+        wid.setSchemaWatching(true);
+        wid.addJsonPanel("Schema", a.arguments()[schema_arg + 1]);
+    }
+    // typed access to the settings of the schema
+    wid.setWindowTitle(readSetting<example::logging::enabled>(settings) ? "Settings (logging enabled)" : "Settings");
 
     wid.show();
 
@@ -0,0 +1,130 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <iostream>
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QStringList>
+#include "settingsdiff.h"
+
+/**
+ * Compares two ini files using the types of json schemas and prints the differences grouped by
+ * panel and section:
+ *
+ *     ~ key: left -> right    the values differ
+ *     - key: left             only the left file has a value
+ *     + key: right            only the right file has a value
+ *     = key: value            only one file has a value, but it is the default
+ *
+ * Usage: settingswidget_diff [--schema [<panel>=]<schema.json>]... [--hide-defaults] <left.ini> <right.ini>
+ * Exits with 0 if the files are equal, 1 if they differ and 2 on errors, like diff.
+ */
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList arguments = app.arguments();
+    SettingsDiff diff;
+    QStringList files;
+    bool hide_defaults = false;
+    for (int i=1; i<arguments.size(); ++i)
+    {
+        if (arguments[i] == "--schema" and i+1 < arguments.size())
+        {
+            QString schema = arguments[++i];
+            QString name = QFileInfo(schema).completeBaseName();
+            int idx = schema.indexOf('=');
+            if (idx > 0)
+            {
+                name = schema.left(idx);
+                schema = schema.mid(idx + 1);
+            }
+            if (!diff.addPanel(name, schema))
+            {
+                std::cerr << "Could not load " << schema.toStdString() << std::endl;
+                return 2;
+            }
+        }
+        else if (arguments[i] == "--hide-defaults")
+        {
+            hide_defaults = true;
+        }
+        else
+        {
+            files << arguments[i];
+        }
+    }
+    if (files.size() != 2)
+    {
+        std::cerr << "Usage: settingswidget_diff [--schema [<panel>=]<schema.json>]... [--hide-defaults] "
+                  << "<left.ini> <right.ini>" << std::endl;
+        return 2;
+    }
+    for (const QString& file: files)
+    {
+        if (!QFileInfo::exists(file))
+        {
+            std::cerr << "No such file " << file.toStdString() << std::endl;
+            return 2;
+        }
+    }
+
+    QSettings left(files[0], QSettings::IniFormat);
+    QSettings right(files[1], QSettings::IniFormat);
+    QString group;
+    bool first_group = true;
+    int shown = 0;
+    diff.compare(&left, &right, [&](const SettingsDiff::Difference& difference) {
+        if (hide_defaults and difference.kind == SettingsDiff::DefaultEqual)
+        {
+            return;
+        }
+        ++shown;
+        QString current = "[" + (difference.panel.isEmpty() ? QString("unknown") : difference.panel) + "] "
+                          + difference.section;
+        if (first_group or current != group)
+        {
+            std::cout << (first_group ? "" : "\n") << current.toStdString() << "\n";
+            group = current;
+            first_group = false;
+        }
+        std::cout << "  ";
+        switch (difference.kind)
+        {
+            case SettingsDiff::Changed:
+                std::cout << "~ " << difference.key.toStdString() << ": " << difference.left_text.toStdString()
+                          << " -> " << difference.right_text.toStdString();
+                break;
+            case SettingsDiff::OnlyLeft:
+                std::cout << "- " << difference.key.toStdString() << ": " << difference.left_text.toStdString();
+                break;
+            case SettingsDiff::OnlyRight:
+                std::cout << "+ " << difference.key.toStdString() << ": " << difference.right_text.toStdString();
+                break;
+            case SettingsDiff::DefaultEqual:
+                std::cout << "= " << difference.key.toStdString() << ": "
+                          << (difference.left.isValid() ? difference.left_text : difference.right_text).toStdString();
+                break;
+        }
+        std::cout << "\n";
+    });
+    std::cout.flush();
+    return shown > 0 ? 1 : 0;
+}
@@ -0,0 +1,347 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <QDebug>
+#include "settingcondition.h"
+
+
+struct SettingCondition::Node
+{
+    enum Kind : int8_t {Reference, Equals, NotEquals, Not, And, Or};
+
+    Kind kind;
+    QString path;
+    QVariant literal;
+    std::shared_ptr<const Node> left;
+    std::shared_ptr<const Node> right;
+};
+
+
+namespace
+{
+    typedef std::shared_ptr<SettingCondition::Node> NodePtr;
+
+    bool isTruthy(const QVariant& value)
+    {
+        if (!value.isValid())
+        {
+            return false;
+        }
+        if (value.type() == QVariant::String)
+        {
+            // QSettings returns strings for most values of ini files
+            QString str = value.toString().toLower();
+            return !(str.isEmpty() or str == "false" or str == "0");
+        }
+        return value.toBool();
+    }
+
+    bool isEqual(const QVariant& value, const QVariant& literal)
+    {
+        if (!value.isValid())
+        {
+            return false;
+        }
+        switch(literal.type())
+        {
+            case QVariant::Bool:
+                return isTruthy(value) == literal.toBool();
+            case QVariant::Double:
+            {
+                bool ok = false;
+                double number = value.toDouble(&ok);
+                return ok and number == literal.toDouble();
+            }
+            default:
+                return value.toString() == literal.toString();
+        }
+    }
+
+    /**
+     * @brief Recursive descent parser for condition expressions
+     */
+    class Parser
+    {
+    public:
+        Parser(const QString& expression, QStringList& references)
+            : _expr(expression), _pos(0), _references(references)
+        {
+        }
+
+        NodePtr parse()
+        {
+            NodePtr node = parseOr();
+            skipSpaces();
+            if (!node or _pos != _expr.size())
+            {
+                return NodePtr();
+            }
+            return node;
+        }
+
+    private:
+        const QString& _expr;
+        int _pos;
+        QStringList& _references;
+
+        void skipSpaces()
+        {
+            while (_pos < _expr.size() and _expr[_pos].isSpace())
+            {
+                ++_pos;
+            }
+        }
+
+        bool accept(const char* token)
+        {
+            skipSpaces();
+            QLatin1String tok(token);
+            if (_expr.midRef(_pos, tok.size()) == tok)
+            {
+                _pos += tok.size();
+                return true;
+            }
+            return false;
+        }
+
+        static bool isWordChar(QChar c)
+        {
+            return !(c.isSpace() or c == '(' or c == ')' or c == '!' or c == '=' or
+                     c == '&' or c == '|' or c == '\'' or c == '"');
+        }
+
+        QString word()
+        {
+            skipSpaces();
+            int start = _pos;
+            while (_pos < _expr.size() and isWordChar(_expr[_pos]))
+            {
+                ++_pos;
+            }
+            return _expr.mid(start, _pos - start);
+        }
+
+        bool literal(QVariant& value)
+        {
+            skipSpaces();
+            if (_pos < _expr.size() and (_expr[_pos] == '\'' or _expr[_pos] == '"'))
+            {
+                QChar quote = _expr[_pos];
+                int end = _expr.indexOf(quote, _pos + 1);
+                if (end < 0)
+                {
+                    return false;
+                }
+                value = _expr.mid(_pos + 1, end - _pos - 1);
+                _pos = end + 1;
+                return true;
+            }
+
+            QString str = word();
+            if (str.isEmpty())
+            {
+                return false;
+            }
+            bool is_number = false;
+            double number = str.toDouble(&is_number);
+            if (str == "true" or str == "false")
+            {
+                value = (str == "true");
+            }
+            else if (is_number)
+            {
+                value = number;
+            }
+            else
+            {
+                value = str;
+            }
+            return true;
+        }
+
+        NodePtr binary(Node::Kind kind, NodePtr left, NodePtr right)
+        {
+            if (!left or !right)
+            {
+                return NodePtr();
+            }
+            NodePtr node = std::make_shared<Node>();
+            node->kind = kind;
+            node->left = left;
+            node->right = right;
+            return node;
+        }
+
+        NodePtr parseOr()
+        {
+            NodePtr node = parseAnd();
+            while (node and accept("||"))
+            {
+                node = binary(Node::Or, node, parseAnd());
+            }
+            return node;
+        }
+
+        NodePtr parseAnd()
+        {
+            NodePtr node = parseUnary();
+            while (node and accept("&&"))
+            {
+                node = binary(Node::And, node, parseUnary());
+            }
+            return node;
+        }
+
+        NodePtr parseUnary()
+        {
+            skipSpaces();
+            if (_expr.midRef(_pos, 2) != "!=" and accept("!"))
+            {
+                NodePtr operand = parseUnary();
+                if (!operand)
+                {
+                    return NodePtr();
+                }
+                NodePtr node = std::make_shared<Node>();
+                node->kind = Node::Not;
+                node->left = operand;
+                return node;
+            }
+            if (accept("("))
+            {
+                NodePtr node = parseOr();
+                if (!accept(")"))
+                {
+                    return NodePtr();
+                }
+                return node;
+            }
+            return parseComparison();
+        }
+
+        NodePtr parseComparison()
+        {
+            QString path = word();
+            if (path.isEmpty())
+            {
+                return NodePtr();
+            }
+            if (!_references.contains(path))
+            {
+                _references << path;
+            }
+
+            NodePtr node = std::make_shared<Node>();
+            node->kind = Node::Reference;
+            node->path = path;
+            if (accept("=="))
+            {
+                node->kind = Node::Equals;
+            }
+            else if (accept("!="))
+            {
+                node->kind = Node::NotEquals;
+            }
+            else
+            {
+                return node;
+            }
+
+            if (!literal(node->literal))
+            {
+                return NodePtr();
+            }
+            return node;
+        }
+    };
+
+    bool evaluateNode(const SettingCondition::Node* node, const SettingCondition::Resolver& resolver);
+}
+
+
+SettingCondition::SettingCondition()
+{
+}
+
+
+SettingCondition SettingCondition::parse(const QString& expression, bool* ok)
+{
+    SettingCondition condition;
+    Parser parser(expression, condition._references);
+    NodePtr root = parser.parse();
+    if (ok)
+    {
+        *ok = bool(root);
+    }
+    if (!root)
+    {
+        qWarning() << "Invalid condition expression " << expression;
+        return SettingCondition();
+    }
+    condition._root = root;
+    return condition;
+}
+
+
+bool SettingCondition::isNull() const
+{
+    return !_root;
+}
+
+
+QStringList SettingCondition::references() const
+{
+    return _references;
+}
+
+
+bool SettingCondition::evaluate(const Resolver& resolver) const
+{
+    if (!_root)
+    {
+        return true;
+    }
+    return evaluateNode(_root.get(), resolver);
+}
+
+
+namespace
+{
+    bool evaluateNode(const SettingCondition::Node* node, const SettingCondition::Resolver& resolver)
+    {
+        typedef SettingCondition::Node Node;
+        switch(node->kind)
+        {
+            case Node::Reference:
+                return isTruthy(resolver(node->path));
+            case Node::Equals:
+                return isEqual(resolver(node->path), node->literal);
+            case Node::NotEquals:
+                return !isEqual(resolver(node->path), node->literal);
+            case Node::Not:
+                return !evaluateNode(node->left.get(), resolver);
+            case Node::And:
+                return evaluateNode(node->left.get(), resolver) and evaluateNode(node->right.get(), resolver);
+            case Node::Or:
+                return evaluateNode(node->left.get(), resolver) or evaluateNode(node->right.get(), resolver);
+        }
+        return false;
+    }
+}
@@ -18,12 +18,121 @@
  *
  */
 
+#include <cmath>
+#include <QtConcurrent>
 #include "settingitems.h"
+#include "settingtable.h"
+#include "settingshelp.h"
 
 SettingItem::SettingItem(QSettings* settings, QString section, QString key, QString desc, QWidget* parent)
     : QWidget(parent), _settings(settings), _section(section), _key(key)
 {
-    setToolTip(desc);
+    // the description is looked up by key when a tooltip is shown, items don't keep it
+    if (!desc.isEmpty())
+    {
+        SettingsHelp::setDescription(SettingsStore::path(section, key), desc);
+    }
+}
+
+
+QVariant SettingItem::value() const
+{
+    return QVariant();
+}
+
+
+QVariant SettingItem::defaultValue() const
+{
+    return QVariant();
+}
+
+
+bool SettingItem::isDefault() const
+{
+    return value() == defaultValue();
+}
+
+
+void SettingItem::setValue(const QVariant& value)
+{
+    Q_UNUSED(value);
+    qWarning() << "Setting " << _section << "/" << _key << " does not support changing its value";
+}
+
+
+void SettingItem::reload()
+{
+    loadSetting();
+}
+
+
+QString SettingItem::section() const
+{
+    return _section;
+}
+
+
+QString SettingItem::key() const
+{
+    return _key;
+}
+
+
+QVariant SettingItem::readValue(const QVariant& default_value)
+{
+    QVariant value = SettingsStore::readValue(_settings, _section, _key, default_value);
+    updateSource();
+    return value;
+}
+
+
+void SettingItem::writeValue(const QVariant& value)
+{
+    SettingsStore::writeValue(_settings, _section, _key, value);
+    updateSource();
+}
+
+
+void SettingItem::updateSource()
+{
+    SettingsStore* store = SettingsStore::forSettings(_settings);
+    if (!store)
+    {
+        return;
+    }
+    // allows styling the items depending on the layer with a stylesheet, also shown in the tooltip
+    setProperty("settingLayer", SettingsStore::layerName(store->layer(_section, _key)));
+}
+
+
+QString SettingItem::description() const
+{
+    return SettingsHelp::text(SettingsStore::path(_section, _key));
+}
+
+
+bool SettingItem::event(QEvent* event)
+{
+    if (event->type() != QEvent::ToolTip)
+    {
+        return QWidget::event(event);
+    }
+
+    // the tooltip is only built when it is shown, help texts are loaded on first use
+    QString text = description();
+    QString layer = property("settingLayer").toString();
+    if (!layer.isEmpty())
+    {
+        text += (text.isEmpty() ? "" : "\n\n") + QString("Source: ") + layer;
+    }
+    if (text.isEmpty())
+    {
+        QToolTip::hideText();
+        event->ignore();
+        return true;
+    }
+    QToolTip::showText(static_cast<QHelpEvent*>(event)->globalPos(), text, this);
+    return true;
 }
 
 
@@ -42,6 +151,8 @@ SettingBool::SettingBool(QSettings* settings, QString title, QString section, QS
     layout->addWidget(_checkbox);
     setLayout(layout);
 
+    connect(_checkbox, &QCheckBox::toggled, this, &SettingItem::valueChanged);
+
     // load the settings
     loadSetting();
 }
@@ -65,6 +176,28 @@ SettingItem* SettingBool::fromJsonObject(QJsonObject obj, QSettings* settings, Q
 }
 
 
+bool SettingBool::convertValue(const QJsonObject&, QVariant& value)
+{
+    if (value.type() == QVariant::Bool)
+    {
+        return true;
+    }
+    // ini files store booleans as strings
+    QString str = value.toString().toLower();
+    if (str == "true" or str == "1")
+    {
+        value = true;
+        return true;
+    }
+    if (str == "false" or str == "0")
+    {
+        value = false;
+        return true;
+    }
+    return false;
+}
+
+
 void SettingBool::restoreDefault()
 {
     _checkbox->setChecked(_default_value);
@@ -73,18 +206,32 @@ void SettingBool::restoreDefault()
 
 void SettingBool::loadSetting()
 {
-    _settings->beginGroup(_section);
-    bool value = _settings->value(_key, _default_value).toBool();
+    bool value = readValue(_default_value).toBool();
     _checkbox->setChecked(value);
-    _settings->endGroup();
 }
 
 
 void SettingBool::saveSetting()
 {
-    _settings->beginGroup(_section);
-    _settings->setValue(_key, _checkbox->isChecked());
-    _settings->endGroup();
+    writeValue(_checkbox->isChecked());
+}
+
+
+QVariant SettingBool::value() const
+{
+    return _checkbox->isChecked();
+}
+
+
+QVariant SettingBool::defaultValue() const
+{
+    return _default_value;
+}
+
+
+void SettingBool::setValue(const QVariant& value)
+{
+    _checkbox->setChecked(value.toBool());
 }
 
 
@@ -103,11 +250,22 @@ SettingString::SettingString(QSettings* settings, QString title, QString section
     layout->addWidget(_line_edit);
     setLayout(layout);
 
+    connect(_line_edit, &QLineEdit::textChanged, this, &SettingItem::valueChanged);
+
     // load the settings
     loadSetting();
 }
 
 
+SettingString::~SettingString()
+{
+    if (_async_cancelled)
+    {
+        *_async_cancelled = true;
+    }
+}
+
+
 SettingItem* SettingString::fromJsonObject(QJsonObject obj, QSettings* settings, QWidget* parent)
 {
     if (!obj.contains("title") or !obj.contains("section") or !obj.contains("key"))
@@ -122,7 +280,25 @@ SettingItem* SettingString::fromJsonObject(QJsonObject obj, QSettings* settings,
     QString default_value = obj["default"].toString();
     QString desc = obj["desc"].toString();
 
-    return new SettingString(settings, title, section, key, default_value, desc, parent);
+    auto item = new SettingString(settings, title, section, key, default_value, desc, parent);
+    SettingValidator validator = SettingValidator::fromJsonObject(obj);
+    if (!validator.isNull())
+    {
+        item->setValidator(validator);
+    }
+    return item;
+}
+
+
+bool SettingString::convertValue(const QJsonObject& obj, QVariant& value)
+{
+    if (value.type() == QVariant::List or value.type() == QVariant::Map or !value.canConvert<QString>())
+    {
+        return false;
+    }
+    value = value.toString();
+    // only the fast checks, asynchronous validators are meant for interactive feedback
+    return SettingValidator::fromJsonObject(obj).validate(value.toString()).isEmpty();
 }
 
 
@@ -134,18 +310,124 @@ void SettingString::restoreDefault()
 
 void SettingString::loadSetting()
 {
-    _settings->beginGroup(_section);
-    QString value = _settings->value(_key, _default_value).toString();
+    QString value = readValue(_default_value).toString();
     _line_edit->setText(value);
-    _settings->endGroup();
 }
 
 
 void SettingString::saveSetting()
 {
-    _settings->beginGroup(_section);
-    _settings->setValue(_key, _line_edit->text());
-    _settings->endGroup();
+    if (!isValid())
+    {
+        qWarning() << "Not saving invalid value of " << _section << "/" << _key << ": " << _error;
+        return;
+    }
+    writeValue(_line_edit->text());
+}
+
+
+QVariant SettingString::value() const
+{
+    return _line_edit->text();
+}
+
+
+QVariant SettingString::defaultValue() const
+{
+    return _default_value;
+}
+
+
+void SettingString::setValue(const QVariant& value)
+{
+    _line_edit->setText(value.toString());
+}
+
+
+void SettingString::setValidator(SettingValidator validator)
+{
+    bool first_validator = _validator.isNull();
+    _validator = validator;
+    if (first_validator)
+    {
+        connect(_line_edit, &QLineEdit::textChanged, this, &SettingString::validate);
+    }
+    if (_validator.asyncValidator() and !_async_timer)
+    {
+        _async_timer = new QTimer(this);
+        _async_timer->setSingleShot(true);
+        _async_timer->setInterval(200);
+        connect(_async_timer, &QTimer::timeout, this, &SettingString::startAsyncValidation);
+        _async_watcher = new QFutureWatcher<QString>(this);
+        connect(_async_watcher, &QFutureWatcher<QString>::finished, this, &SettingString::finishAsyncValidation);
+    }
+    validate();
+}
+
+
+bool SettingString::isValid() const
+{
+    return _error.isEmpty();
+}
+
+
+void SettingString::validate()
+{
+    // a running asynchronous check is stale now
+    if (_async_cancelled)
+    {
+        *_async_cancelled = true;
+        _async_cancelled.reset();
+    }
+
+    _error = _validator.validate(_line_edit->text());
+    if (_error.isEmpty() and _validator.asyncValidator())
+    {
+        _async_timer->start();
+    }
+    showValidity();
+}
+
+
+void SettingString::startAsyncValidation()
+{
+    SettingValidator::AsyncValidator validator = _validator.asyncValidator();
+    QString text = _line_edit->text();
+    auto cancelled = std::make_shared<std::atomic<bool>>(false);
+    _async_cancelled = cancelled;
+    _async_watcher->setFuture(QtConcurrent::run([validator, text, cancelled]() {
+        return *cancelled ? QString() : validator(text, *cancelled);
+    }));
+}
+
+
+void SettingString::finishAsyncValidation()
+{
+    if (!_async_cancelled or *_async_cancelled)
+    {
+        // the text changed while the check was running
+        return;
+    }
+    _async_cancelled.reset();
+    _error = _async_watcher->result();
+    showValidity();
+}
+
+
+void SettingString::showValidity()
+{
+    if (_error.isEmpty())
+    {
+        _line_edit->setPalette(QPalette());
+        _line_edit->setToolTip(QString());
+    }
+    else
+    {
+        QPalette palette = _line_edit->palette();
+        palette.setColor(QPalette::Base, QColor(255, 210, 210));
+        _line_edit->setPalette(palette);
+        _line_edit->setToolTip(_error);
+    }
 }
 
 
@@ -181,6 +463,7 @@ SettingPath::SettingPath(QSettings* settings, QString title, QString section, QS
 
     // connect the Push button
     connect(_btn, &QPushButton::clicked, this, &SettingPath::showFileDialog);
+    connect(_line_edit, &QLineEdit::textChanged, this, &SettingItem::valueChanged);
 
     // load the settings
     loadSetting();
@@ -228,6 +511,12 @@ SettingItem* SettingPath::fromJsonObject(QJsonObject obj, QSettings* settings, Q
 }
 
 
+bool SettingPath::convertValue(const QJsonObject& obj, QVariant& value)
+{
+    return SettingString::convertValue(obj, value);
+}
+
+
 void SettingPath::restoreDefault()
 {
     _line_edit->setText(_default_value);
@@ -236,18 +525,32 @@ void SettingPath::restoreDefault()
 
 void SettingPath::loadSetting()
 {
-    _settings->beginGroup(_section);
-    QString value = _settings->value(_key, _default_value).toString();
+    QString value = readValue(_default_value).toString();
     _line_edit->setText(value);
-    _settings->endGroup();
 }
 
 
 void SettingPath::saveSetting()
 {
-    _settings->beginGroup(_section);
-    _settings->setValue(_key, _line_edit->text());
-    _settings->endGroup();
+    writeValue(_line_edit->text());
+}
+
+
+QVariant SettingPath::value() const
+{
+    return _line_edit->text();
+}
+
+
+QVariant SettingPath::defaultValue() const
+{
+    return _default_value;
+}
+
+
+void SettingPath::setValue(const QVariant& value)
+{
+    _line_edit->setText(value.toString());
 }
 
 
@@ -290,6 +593,9 @@ SettingNumeric::SettingNumeric(QSettings* settings, QString title, QString secti
     layout->addWidget(_spinbox);
     setLayout(layout);
 
+    connect(_spinbox, static_cast<void (QDoubleSpinBox::*)(double)>(&QDoubleSpinBox::valueChanged),
+            this, &SettingItem::valueChanged);
+
     // load the settings
     loadSetting();
 }
@@ -328,6 +634,25 @@ SettingItem* SettingNumeric::fromJsonObject(QJsonObject obj, QSettings* settings
 }
 
 
+bool SettingNumeric::convertValue(const QJsonObject& obj, QVariant& value)
+{
+    bool ok = false;
+    double number = value.toDouble(&ok);
+    if (!ok)
+    {
+        return false;
+    }
+    double minimum = obj.contains("minimum") ? obj.value("minimum").toDouble() : 0;
+    double maximum = obj.contains("maximum") ? obj.value("maximum").toDouble() : 99;
+    if (number < minimum or number > maximum)
+    {
+        return false;
+    }
+    value = number;
+    return true;
+}
+
+
 void SettingNumeric::restoreDefault()
 {
     _spinbox->setValue(_default_value);
@@ -336,18 +661,40 @@ void SettingNumeric::restoreDefault()
 
 void SettingNumeric::loadSetting()
 {
-    _settings->beginGroup(_section);
-    double value = _settings->value(_key, _default_value).toDouble();
+    double value = readValue(_default_value).toDouble();
     _spinbox->setValue(value);
-    _settings->endGroup();
 }
 
 
 void SettingNumeric::saveSetting()
 {
-    _settings->beginGroup(_section);
-    _settings->setValue(_key, _spinbox->value());
-    _settings->endGroup();
+    writeValue(_spinbox->value());
+}
+
+
+QVariant SettingNumeric::value() const
+{
+    return _spinbox->value();
+}
+
+
+QVariant SettingNumeric::defaultValue() const
+{
+    return _default_value;
+}
+
+
+void SettingNumeric::setValue(const QVariant& value)
+{
+    _spinbox->setValue(value.toDouble());
+}
+
+
+bool SettingNumeric::isDefault() const
+{
+    // the spinbox rounds the default to its decimals
+    double scale = std::pow(10.0, _spinbox->decimals());
+    return qRound64(_spinbox->value() * scale) == qRound64(_default_value * scale);
 }
 
 
@@ -355,31 +702,125 @@ void SettingNumeric::saveSetting()
 // SettingOptions
 /////////////////////////////
 
+namespace
+{
+    /**
+     * @brief QComboBox that announces when its popup is about to be shown
+     */
+    class LazyComboBox : public QComboBox
+    {
+    public:
+
+        LazyComboBox(QWidget* parent) : QComboBox(parent) {}
+
+        std::function<void()> about_to_show;
+
+        void showPopup()
+        {
+            if (about_to_show)
+            {
+                about_to_show();
+            }
+            QComboBox::showPopup();
+        }
+    };
+
+    struct RegisteredProvider
+    {
+        SettingOptions::OptionProvider function;
+        int ttl;
+    };
+
+    struct CachedOptions
+    {
+        QVariantMap options;
+        /**
+         * @brief Incremented with every load, so items know whether they show the latest options
+         */
+        int version = -1;
+        QElapsedTimer loaded;
+        QFuture<QVariantMap> loading;
+        /**
+         * @brief The result of loading is not in the cache yet
+         */
+        bool pending = false;
+    };
+
+    QHash<QString, RegisteredProvider> _providers;
+
+    /**
+     * @brief Options by provider and arguments
+     */
+    QHash<QString, CachedOptions> _option_cache;
+}
+
+
 SettingOptions::SettingOptions(QSettings* settings, QString title, QString section, QString key,
                                QVariant default_value, QVariantMap options,
                                QString desc, QWidget* parent)
     : SettingItem(settings, section, key, desc, parent), _default_value(default_value)
 {
-    auto layout = new QHBoxLayout(this);
-    QLabel* label = new QLabel(title, this);
     _combobox = new QComboBox(this);
-    layout->addWidget(label);
-    layout->addWidget(_combobox);
-    setLayout(layout);
+    setupLayout(title);
 
     for (auto i: options.toStdMap())
     {
         _combobox->addItem(i.first, i.second);
     }
 
+    connect(_combobox, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
+            this, &SettingItem::valueChanged);
+
+    // load the settings
+    loadSetting();
+}
+
+
+SettingOptions::SettingOptions(QSettings* settings, QString title, QString section, QString key,
+                               QVariant default_value, QString provider, QJsonObject provider_args,
+                               QString desc, QWidget* parent)
+    : SettingItem(settings, section, key, desc, parent), _default_value(default_value),
+      _provider(provider), _provider_args(provider_args)
+{
+    auto combobox = new LazyComboBox(this);
+    combobox->about_to_show = [this]() { loadOptions(); };
+    _combobox = combobox;
+    setupLayout(title);
+
+    // options that were loaded for another item can be shown right away
+    auto cached = _option_cache.constFind(providerKey());
+    if (cached != _option_cache.constEnd() and cached.value().version >= 0)
+    {
+        _options_version = cached.value().version;
+        setOptions(cached.value().options);
+    }
+
+    connect(_combobox, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
+            this, &SettingItem::valueChanged);
+
     // load the settings
     loadSetting();
 }
 
 
+void SettingOptions::registerProvider(QString name, OptionProvider provider, int ttl)
+{
+    if (_providers.contains(name))
+    {
+        qWarning() << name << " allready exists - not adding the new provider";
+        return;
+    }
+    RegisteredProvider registered;
+    registered.function = provider;
+    registered.ttl = ttl;
+    _providers[name] = registered;
+}
+
+
 SettingItem* SettingOptions::fromJsonObject(QJsonObject obj, QSettings* settings, QWidget* parent)
 {
-    if (!obj.contains("title") or !obj.contains("section") or !obj.contains("key") or !obj.contains("options"))
+    if (!obj.contains("title") or !obj.contains("section") or !obj.contains("key")
+        or !(obj.contains("options") or obj.contains("provider")))
     {
         qWarning() << "SettingOptions item created from json is missing (a) mandatory field(s)";
         return nullptr;
@@ -390,12 +831,40 @@ SettingItem* SettingOptions::fromJsonObject(QJsonObject obj, QSettings* settings
     QString key = obj["key"].toString();
     QVariant default_value = obj["default"].toVariant();
     QString desc = obj["desc"].toString();
+    if (obj.contains("provider"))
+    {
+        return new SettingOptions(settings, title, section, key, default_value, obj["provider"].toString(),
+                                  obj["provider_args"].toObject(), desc, parent);
+    }
     QVariantMap options = obj["options"].toObject().toVariantMap();
 
     return new SettingOptions(settings, title, section, key, default_value, options, desc, parent);
 }
 
 
+bool SettingOptions::convertValue(const QJsonObject& obj, QVariant& value)
+{
+    if (obj.contains("provider"))
+    {
+        // the options are not known without running the provider
+        return value.isValid();
+    }
+    // compare the string representation, ini files don't keep the type of the value
+    QString str = value.toString();
+    QJsonObject options = obj.value("options").toObject();
+    for (auto it = options.constBegin(); it != options.constEnd(); ++it)
+    {
+        QVariant option = it.value().toVariant();
+        if (option.toString() == str)
+        {
+            value = option;
+            return true;
+        }
+    }
+    return false;
+}
+
+
 void SettingOptions::addItem(const QString& text, const QVariant& userData)
 {
     _combobox->addItem(text, userData);
@@ -404,23 +873,144 @@ void SettingOptions::addItem(const QString& text, const QVariant& userData)
 
 void SettingOptions::restoreDefault()
 {
-    _combobox->setCurrentIndex(_combobox->findData(_default_value));
+    selectValue(_default_value);
 }
 
 
 void SettingOptions::loadSetting()
 {
-    _settings->beginGroup(_section);
-    _combobox->setCurrentIndex(_combobox->findData(_settings->value(_key, _default_value)));
-    _settings->endGroup();
+    selectValue(readValue(_default_value));
 }
 
 
 void SettingOptions::saveSetting()
 {
-    _settings->beginGroup(_section);
-    _settings->setValue(_key, _combobox->currentData());
-    _settings->endGroup();
+    writeValue(_combobox->currentData());
+}
+
+
+QVariant SettingOptions::value() const
+{
+    return _combobox->currentData();
+}
+
+
+QVariant SettingOptions::defaultValue() const
+{
+    return _default_value;
+}
+
+
+bool SettingOptions::isDefault() const
+{
+    // values read from ini files are strings, the options keep their json type
+    return value().toString() == _default_value.toString();
+}
+
+
+void SettingOptions::setValue(const QVariant& value)
+{
+    selectValue(value);
+}
+
+
+void SettingOptions::setupLayout(const QString& title)
+{
+    auto layout = new QHBoxLayout(this);
+    QLabel* label = new QLabel(title, this);
+    layout->addWidget(label);
+    layout->addWidget(_combobox);
+    setLayout(layout);
+}
+
+
+void SettingOptions::selectValue(const QVariant& value)
+{
+    int idx = _combobox->findData(value);
+    if (idx < 0 and !_provider.isEmpty() and value.isValid())
+    {
+        // keep showing the value until the options are known
+        _combobox->addItem(value.toString(), value);
+        idx = _combobox->count() - 1;
+    }
+    _combobox->setCurrentIndex(idx);
+}
+
+
+void SettingOptions::loadOptions()
+{
+    auto provider = _providers.constFind(_provider);
+    if (provider == _providers.constEnd())
+    {
+        qWarning() << _provider << " is no registered option provider";
+        return;
+    }
+
+    CachedOptions& cached = _option_cache[providerKey()];
+    if (cached.version != _options_version)
+    {
+        _options_version = cached.version;
+        setOptions(cached.options);
+    }
+    bool expired = !cached.loaded.isValid() or cached.loaded.hasExpired(provider.value().ttl);
+    if (!expired or (_options_watcher and _options_watcher->isRunning()))
+    {
+        return;
+    }
+
+    // items with the same provider share the running load
+    if (!cached.pending)
+    {
+        OptionProvider function = provider.value().function;
+        QJsonObject args = _provider_args;
+        cached.loading = QtConcurrent::run([function, args]() { return function(args); });
+        cached.pending = true;
+    }
+    if (!_options_watcher)
+    {
+        _options_watcher = new QFutureWatcher<QVariantMap>(this);
+        connect(_options_watcher, &QFutureWatcher<QVariantMap>::finished,
+                this, &SettingOptions::finishLoadingOptions);
+    }
+    _options_watcher->setFuture(cached.loading);
+}
+
+
+void SettingOptions::finishLoadingOptions()
+{
+    CachedOptions& cached = _option_cache[providerKey()];
+    if (cached.pending and cached.loading == _options_watcher->future())
+    {
+        // the first item to finish updates the cache for all items
+        cached.options = _options_watcher->result();
+        cached.loaded.start();
+        cached.pending = false;
+        ++cached.version;
+    }
+    if (cached.version != _options_version)
+    {
+        _options_version = cached.version;
+        setOptions(cached.options);
+    }
+}
+
+
+void SettingOptions::setOptions(const QVariantMap& options)
+{
+    QVariant current = _combobox->currentData();
+    QSignalBlocker blocker(_combobox);
+    _combobox->clear();
+    for (auto it = options.constBegin(); it != options.constEnd(); ++it)
+    {
+        _combobox->addItem(it.key(), it.value());
+    }
+    selectValue(current);
+}
+
+
+QString SettingOptions::providerKey() const
+{
+    return _provider + "\n" + QString::fromUtf8(QJsonDocument(_provider_args).toJson(QJsonDocument::Compact));
 }
 
 
@@ -437,10 +1027,31 @@ namespace SettingItemCreation
                                     {"string", SettingString::fromJsonObject},
                                     {"path", SettingPath::fromJsonObject},
                                     {"numeric", SettingNumeric::fromJsonObject},
-                                    {"options", SettingOptions::fromJsonObject}};
+                                    {"options", SettingOptions::fromJsonObject},
+                                    {"list", SettingTable::fromJsonObject},
+                                    {"table", SettingTable::fromJsonObject}};
+
+        QMap<QString, SettingValueConverter> _convertermap = {{"bool", SettingBool::convertValue},
+                                                              {"string", SettingString::convertValue},
+                                                              {"path", SettingPath::convertValue},
+                                                              {"numeric", SettingNumeric::convertValue},
+                                                              {"options", SettingOptions::convertValue},
+                                                              {"list", SettingTable::convertValue},
+                                                              {"table", SettingTable::convertValue}};
+
+        QMap<QString, SettingValueStorage> _storagemap = {{"list", {SettingTable::readRows, SettingTable::writeRows}},
+                                                          {"table", {SettingTable::readRows, SettingTable::writeRows}}};
+
+        // the built-in items read a missing default as the empty value of their type
+        const QMap<QString, QVariant> _emptydefaults = {{"bool", false},
+                                                        {"string", QString()},
+                                                        {"path", QString()},
+                                                        {"numeric", 0.0},
+                                                        {"list", QVariantList()},
+                                                        {"table", QVariantList()}};
     }
 
-    void registerType(QString identifier, SettingItemFactory factory)
+    void registerType(QString identifier, SettingItemFactory factory, SettingValueConverter converter)
     {
         if (_typemap.contains(identifier))
         {
@@ -448,6 +1059,97 @@ namespace SettingItemCreation
             return;
         }
         _typemap[identifier] = factory;
+        if (converter)
+        {
+            _convertermap[identifier] = converter;
+        }
+    }
+
+    bool isRegistered(const QString& identifier)
+    {
+        return _typemap.contains(identifier);
+    }
+
+    bool convertValue(const QJsonObject& json, QVariant& value)
+    {
+        if (!value.isValid())
+        {
+            return false;
+        }
+        SettingValueConverter converter = _convertermap.value(json.value("type").toString(), nullptr);
+        if (!converter)
+        {
+            return true;
+        }
+        return converter(json, value);
+    }
+
+    QVariant defaultValue(const QJsonObject& json)
+    {
+        QVariant value = json.contains("default") ? json.value("default").toVariant()
+                                                   : _emptydefaults.value(json.value("type").toString());
+        if (!convertValue(json, value))
+        {
+            return QVariant();
+        }
+        return value;
+    }
+
+    void registerStorage(QString identifier, SettingValueStorage storage)
+    {
+        if (_storagemap.contains(identifier))
+        {
+            qWarning() << identifier << " allready has a custom storage - not adding the new one";
+            return;
+        }
+        _storagemap[identifier] = storage;
+    }
+
+    QVariant readValue(const QJsonObject& json, QSettings* settings)
+    {
+        QString section = json.value("section").toString();
+        QString key = json.value("key").toString();
+        auto it = _storagemap.constFind(json.value("type").toString());
+        if (it == _storagemap.constEnd())
+        {
+            return SettingsStore::readValue(settings, section, key, QVariant());
+        }
+        return it.value().reader(settings, section, key);
+    }
+
+    QVariant readUserValue(const QJsonObject& json, QSettings* settings)
+    {
+        QString section = json.value("section").toString();
+        QString key = json.value("key").toString();
+        auto it = _storagemap.constFind(json.value("type").toString());
+        if (it == _storagemap.constEnd())
+        {
+            return SettingsStore::readUserValue(settings, section, key);
+        }
+        // custom layouts spread the value over keys below "section/key"
+        if (!SettingsStore::containsUserValues(settings, section, key))
+        {
+            return QVariant();
+        }
+        return it.value().reader(settings, section, key);
+    }
+
+    void writeValue(const QJsonObject& json, QSettings* settings, const QVariant& value)
+    {
+        QString section = json.value("section").toString();
+        QString key = json.value("key").toString();
+        auto it = _storagemap.constFind(json.value("type").toString());
+        if (it == _storagemap.constEnd())
+        {
+            SettingsStore::writeValue(settings, section, key, value);
+            return;
+        }
+        it.value().writer(settings, section, key, value);
+    }
+
+    bool hasCustomStorage(const QString& identifier)
+    {
+        return _storagemap.contains(identifier);
     }
 
     SettingItem* createItemfromJson(QJsonObject json, QSettings* settings, QWidget* parent)
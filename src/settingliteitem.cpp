@@ -0,0 +1,422 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cmath>
+#include "settingliteitem.h"
+
+SettingLiteItem::SettingLiteItem(QJsonObject json, QSettings* settings, QWidget* parent)
+    : SettingItem(settings, json.value("section").toString(), json.value("key").toString(),
+                  json.value("desc").toString(), parent),
+      _json(json), _title(json.value("title").toString())
+{
+    QString type = json.value("type").toString();
+    _default_value = json.value("default").toVariant();
+    if (!_default_value.isValid())
+    {
+        // the same defaults as the real items
+        if (type == "bool")
+        {
+            _default_value = false;
+        }
+        else if (type == "numeric")
+        {
+            _default_value = 0.0;
+        }
+        else if (type == "string" or type == "path")
+        {
+            _default_value = QString();
+        }
+        else if (type == "list" or type == "table")
+        {
+            _default_value = QVariantList();
+        }
+    }
+    SettingItemCreation::convertValue(json, _default_value);
+
+    setFocusPolicy(Qt::StrongFocus);
+    setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Fixed);
+
+    // load the settings
+    loadSetting();
+}
+
+
+SettingItem* SettingLiteItem::fromJsonObject(QJsonObject obj, QSettings* settings, QWidget* parent)
+{
+    if (!obj.contains("title") or !obj.contains("section") or !obj.contains("key"))
+    {
+        qWarning() << "SettingLiteItem created from json is missing (a) mandatory field(s)";
+        return nullptr;
+    }
+    QString type = obj["type"].toString();
+    if (!SettingItemCreation::isRegistered(type))
+    {
+        qWarning() << type << " is no registered type - Skipping item";
+        return nullptr;
+    }
+    return new SettingLiteItem(obj, settings, parent);
+}
+
+
+void SettingLiteItem::restoreDefault()
+{
+    if (_editor)
+    {
+        _editor->restoreDefault();
+        return;
+    }
+    setValue(_default_value);
+}
+
+
+void SettingLiteItem::loadSetting()
+{
+    if (_editor)
+    {
+        _editor->reload();
+        return;
+    }
+
+    QVariant value;
+    if (SettingItemCreation::hasCustomStorage(_json.value("type").toString()))
+    {
+        value = SettingItemCreation::readValue(_json, _settings);
+        updateSource();
+    }
+    else
+    {
+        value = readValue(_default_value);
+    }
+    if (!value.isValid())
+    {
+        value = _default_value;
+    }
+    // ini files don't keep the type of the value
+    SettingItemCreation::convertValue(_json, value);
+    setValue(value);
+}
+
+
+void SettingLiteItem::saveSetting()
+{
+    if (_editor)
+    {
+        _editor->saveSetting();
+        return;
+    }
+    if (SettingItemCreation::hasCustomStorage(_json.value("type").toString()))
+    {
+        SettingItemCreation::writeValue(_json, _settings, _value);
+        updateSource();
+        return;
+    }
+    writeValue(_value);
+}
+
+
+QVariant SettingLiteItem::value() const
+{
+    return _editor ? _editor->value() : _value;
+}
+
+
+QVariant SettingLiteItem::defaultValue() const
+{
+    return _editor ? _editor->defaultValue() : _default_value;
+}
+
+
+bool SettingLiteItem::isDefault() const
+{
+    if (_editor)
+    {
+        return _editor->isDefault();
+    }
+    if (_json.value("type").toString() == "numeric")
+    {
+        // the editor rounds the value to its decimals
+        double scale = std::pow(10.0, _json.value("decimals").toInt(2));
+        return qRound64(_value.toDouble() * scale) == qRound64(_default_value.toDouble() * scale);
+    }
+    if (_value.type() == QVariant::List)
+    {
+        return _value == _default_value;
+    }
+    // values read from ini files are strings
+    return _value.toString() == _default_value.toString();
+}
+
+
+void SettingLiteItem::setValue(const QVariant& value)
+{
+    if (_editor)
+    {
+        _editor->setValue(value);
+        return;
+    }
+    if (value == _value)
+    {
+        return;
+    }
+    _value = value;
+    update();
+    emit valueChanged();
+}
+
+
+SettingItem* SettingLiteItem::editor() const
+{
+    return _editor;
+}
+
+
+void SettingLiteItem::activate()
+{
+    if (_editor)
+    {
+        return;
+    }
+    _editor = SettingItemCreation::createItemfromJson(_json, _settings, this);
+    if (!_editor)
+    {
+        qWarning() << "Couldn't create the editor of " << _section << "/" << _key;
+        return;
+    }
+    // carry over unsaved changes, the editor loaded the stored value
+    QVariant loaded = _editor->value();
+    if (loaded.isValid() and loaded != _value)
+    {
+        _editor->setValue(_value);
+    }
+    _value = QVariant();
+    connect(_editor, &SettingItem::valueChanged, this, &SettingItem::valueChanged);
+
+    auto layout = new QHBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(_editor);
+    setLayout(layout);
+    setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Preferred);
+    _editor->show();
+
+    // the widgets of the editor take the place of this item in the focus chain
+    setFocusPolicy(Qt::NoFocus);
+    QWidget* previous = this;
+    for (QWidget* child: _editor->findChildren<QWidget*>())
+    {
+        if (child->focusPolicy() & Qt::TabFocus)
+        {
+            setTabOrder(previous, child);
+            previous = child;
+            if (!_focus_target)
+            {
+                _focus_target = child;
+            }
+        }
+    }
+
+    // the geometry of the editor's widgets is needed right away to pass the click on
+    layout->activate();
+    if (_editor->layout())
+    {
+        _editor->layout()->activate();
+    }
+    updateGeometry();
+}
+
+
+QSize SettingLiteItem::sizeHint() const
+{
+    if (_editor)
+    {
+        return QWidget::sizeHint();
+    }
+    QFontMetrics metrics = fontMetrics();
+    int spacing = style()->pixelMetric(QStyle::PM_LayoutHorizontalSpacing, nullptr, this);
+    QSize value_size;
+    if (isCheckable())
+    {
+        value_size = QSize(style()->pixelMetric(QStyle::PM_IndicatorWidth, nullptr, this),
+                           style()->pixelMetric(QStyle::PM_IndicatorHeight, nullptr, this));
+    }
+    else
+    {
+        // same as QLineEdit
+        QStyleOptionFrame option;
+        option.initFrom(this);
+        option.lineWidth = style()->pixelMetric(QStyle::PM_DefaultFrameWidth, &option, this);
+        QSize contents(metrics.horizontalAdvance(QLatin1Char('x')) * 17 + 4, qMax(metrics.height(), 14) + 2);
+        value_size = style()->sizeFromContents(QStyle::CT_LineEdit, &option, contents, this);
+    }
+    int width = style()->pixelMetric(QStyle::PM_LayoutLeftMargin, nullptr, this)
+                + metrics.horizontalAdvance(_title) + qMax(spacing, 0) + value_size.width()
+                + style()->pixelMetric(QStyle::PM_LayoutRightMargin, nullptr, this);
+    int height = style()->pixelMetric(QStyle::PM_LayoutTopMargin, nullptr, this)
+                 + qMax(metrics.height(), value_size.height())
+                 + style()->pixelMetric(QStyle::PM_LayoutBottomMargin, nullptr, this);
+    return QSize(width, height);
+}
+
+
+QSize SettingLiteItem::minimumSizeHint() const
+{
+    if (_editor)
+    {
+        return QWidget::minimumSizeHint();
+    }
+    QSize size = sizeHint();
+    size.setWidth(qMin(size.width(), fontMetrics().horizontalAdvance(_title) + 8 * fontMetrics().averageCharWidth()));
+    return size;
+}
+
+
+void SettingLiteItem::paintEvent(QPaintEvent* event)
+{
+    if (_editor)
+    {
+        QWidget::paintEvent(event);
+        return;
+    }
+
+    QPainter painter(this);
+    QRect title_rect, value_rect;
+    itemRects(title_rect, value_rect);
+    style()->drawItemText(&painter, title_rect, Qt::AlignLeft | Qt::AlignVCenter, palette(), isEnabled(),
+                          fontMetrics().elidedText(_title, Qt::ElideRight, title_rect.width()), QPalette::WindowText);
+
+    if (isCheckable())
+    {
+        QStyleOptionButton option;
+        option.initFrom(this);
+        option.rect = value_rect;
+        option.state |= _value.toBool() ? QStyle::State_On : QStyle::State_Off;
+        style()->drawPrimitive(QStyle::PE_IndicatorCheckBox, &option, &painter, this);
+        return;
+    }
+
+    QStyleOptionFrame option;
+    option.initFrom(this);
+    option.rect = value_rect;
+    option.lineWidth = style()->pixelMetric(QStyle::PM_DefaultFrameWidth, &option, this);
+    option.state |= QStyle::State_Sunken;
+    style()->drawPrimitive(QStyle::PE_PanelLineEdit, &option, &painter, this);
+    QRect text_rect = style()->subElementRect(QStyle::SE_LineEditContents, &option, this).adjusted(2, 0, -2, 0);
+    style()->drawItemText(&painter, text_rect, Qt::AlignLeft | Qt::AlignVCenter, palette(), isEnabled(),
+                          fontMetrics().elidedText(displayText(), Qt::ElideRight, text_rect.width()), QPalette::Text);
+}
+
+
+void SettingLiteItem::mousePressEvent(QMouseEvent* event)
+{
+    activate();
+    QWidget* target = _editor ? childAt(event->pos()) : nullptr;
+    if (!target)
+    {
+        QWidget::mousePressEvent(event);
+        return;
+    }
+    // the editor didn't exist when the button was pressed, so it gets the press now
+    _click_target = target;
+    QMouseEvent press(event->type(), target->mapFrom(this, event->pos()), event->windowPos(), event->screenPos(),
+                      event->button(), event->buttons(), event->modifiers());
+    QApplication::sendEvent(target, &press);
+}
+
+
+void SettingLiteItem::mouseReleaseEvent(QMouseEvent* event)
+{
+    if (!_click_target)
+    {
+        QWidget::mouseReleaseEvent(event);
+        return;
+    }
+    // the release belongs to the widget that got the forwarded press
+    QPointer<QWidget> target = _click_target;
+    _click_target = nullptr;
+    QMouseEvent release(event->type(), target->mapFrom(this, event->pos()), event->windowPos(), event->screenPos(),
+                        event->button(), event->buttons(), event->modifiers());
+    QApplication::sendEvent(target, &release);
+}
+
+
+void SettingLiteItem::focusInEvent(QFocusEvent* event)
+{
+    QWidget::focusInEvent(event);
+    activate();
+    if (_focus_target)
+    {
+        _focus_target->setFocus(event->reason());
+    }
+}
+
+
+bool SettingLiteItem::isCheckable() const
+{
+    return _json.value("type").toString() == "bool";
+}
+
+
+QString SettingLiteItem::displayText() const
+{
+    QString type = _json.value("type").toString();
+    if (type == "numeric")
+    {
+        return locale().toString(_value.toDouble(), 'f', _json.value("decimals").toInt(2));
+    }
+    if (type == "options")
+    {
+        QJsonObject options = _json.value("options").toObject();
+        for (auto it = options.constBegin(); it != options.constEnd(); ++it)
+        {
+            if (it.value().toVariant().toString() == _value.toString())
+            {
+                return it.key();
+            }
+        }
+    }
+    if (_value.type() == QVariant::List)
+    {
+        return QString("%1 entries").arg(_value.toList().size());
+    }
+    return _value.toString();
+}
+
+
+void SettingLiteItem::itemRects(QRect& title_rect, QRect& value_rect) const
+{
+    QRect area = rect().adjusted(style()->pixelMetric(QStyle::PM_LayoutLeftMargin, nullptr, this),
+                                 style()->pixelMetric(QStyle::PM_LayoutTopMargin, nullptr, this),
+                                 -style()->pixelMetric(QStyle::PM_LayoutRightMargin, nullptr, this),
+                                 -style()->pixelMetric(QStyle::PM_LayoutBottomMargin, nullptr, this));
+    int spacing = qMax(style()->pixelMetric(QStyle::PM_LayoutHorizontalSpacing, nullptr, this), 0);
+
+    if (isCheckable())
+    {
+        // the checkbox has a fixed size and the label takes the remaining space
+        int width = style()->pixelMetric(QStyle::PM_IndicatorWidth, nullptr, this);
+        int height = style()->pixelMetric(QStyle::PM_IndicatorHeight, nullptr, this);
+        value_rect = QRect(area.right() - width + 1, area.center().y() - height / 2, width, height);
+        title_rect = area.adjusted(0, 0, -(width + spacing), 0);
+        return;
+    }
+    // the editors expand and the label keeps its preferred width
+    int title_width = qMin(fontMetrics().horizontalAdvance(_title), area.width() / 2);
+    title_rect = QRect(area.left(), area.top(), title_width, area.height());
+    value_rect = area.adjusted(title_width + spacing, 0, 0, 0);
+}
@@ -0,0 +1,214 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <limits>
+#include "settingsstore.h"
+#include "settingscache.h"
+
+namespace
+{
+    /**
+     * @brief Reader slot indices shared by all caches, a thread keeps its slot until it exits
+     */
+    std::mutex _slot_mutex;
+
+    std::vector<int> _free_slots;
+
+    int _next_slot = 0;
+
+    struct ThreadSlot
+    {
+        int index;
+
+        ThreadSlot(int max_slots)
+        {
+            std::lock_guard<std::mutex> lock(_slot_mutex);
+            if (!_free_slots.empty())
+            {
+                index = _free_slots.back();
+                _free_slots.pop_back();
+            }
+            else
+            {
+                index = _next_slot < max_slots ? _next_slot++ : -1;
+            }
+        }
+
+        ~ThreadSlot()
+        {
+            if (index >= 0)
+            {
+                std::lock_guard<std::mutex> lock(_slot_mutex);
+                _free_slots.push_back(index);
+            }
+        }
+    };
+
+    int threadSlot(int max_slots)
+    {
+        static thread_local ThreadSlot slot(max_slots);
+        return slot.index;
+    }
+}
+
+
+SettingsCache::SettingsCache()
+    : _current(new Snapshot()), _epoch(1)
+{
+    for (auto& epoch: _reader_epochs)
+    {
+        epoch.store(0);
+    }
+}
+
+
+SettingsCache::~SettingsCache()
+{
+    delete _current.load();
+    for (const Retired& retired: _retired)
+    {
+        delete retired.snapshot;
+    }
+}
+
+
+void SettingsCache::publish(const QVariantHash& values)
+{
+    const Snapshot* previous = _current.load(std::memory_order_relaxed);
+    Snapshot* snapshot = new Snapshot(*previous);
+    snapshot->generation = previous->generation + 1;
+    for (auto it = values.constBegin(); it != values.constEnd(); ++it)
+    {
+        auto idx = snapshot->index.constFind(it.key());
+        if (idx == snapshot->index.constEnd())
+        {
+            // new keys are appended, so indices stay valid for all snapshots
+            snapshot->index.insert(it.key(), int(snapshot->values.size()));
+            snapshot->values.push_back(it.value());
+        }
+        else
+        {
+            snapshot->values[idx.value()] = it.value();
+        }
+    }
+
+    _current.store(snapshot, std::memory_order_seq_cst);
+    // readers that load the epoch after this can only load the new snapshot
+    Retired retired;
+    retired.snapshot = previous;
+    retired.epoch = _epoch.fetch_add(1, std::memory_order_seq_cst);
+    _retired.push_back(retired);
+    reclaim();
+}
+
+
+template<typename Read>
+QVariant SettingsCache::read(Read reader) const
+{
+    int slot = threadSlot(_max_readers);
+    if (slot < 0)
+    {
+        std::lock_guard<std::mutex> lock(_fallback_mutex);
+        return reader(_current.load(std::memory_order_acquire));
+    }
+
+    // announce the epoch before loading the snapshot, the writer keeps all snapshots retired since then.
+    // The announced epoch may be outdated already, that only delays freeing snapshots.
+    std::atomic<quint64>& announced = _reader_epochs[slot];
+    announced.store(_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+    QVariant value = reader(_current.load(std::memory_order_seq_cst));
+    announced.store(0, std::memory_order_release);
+    return value;
+}
+
+
+quint64 SettingsCache::generation() const
+{
+    return read([](const Snapshot* snapshot) -> QVariant {
+        return QVariant(snapshot->generation);
+    }).toULongLong();
+}
+
+
+int SettingsCache::indexOf(const QString& path) const
+{
+    return read([&path](const Snapshot* snapshot) -> QVariant {
+        return QVariant(snapshot->index.value(path, -1));
+    }).toInt();
+}
+
+
+QVariant SettingsCache::value(int index) const
+{
+    return read([index](const Snapshot* snapshot) -> QVariant {
+        if (index < 0 or index >= int(snapshot->values.size()))
+        {
+            return QVariant();
+        }
+        return snapshot->values[index];
+    });
+}
+
+
+QVariant SettingsCache::value(const QString& path) const
+{
+    return read([&path](const Snapshot* snapshot) -> QVariant {
+        auto it = snapshot->index.constFind(path);
+        if (it == snapshot->index.constEnd())
+        {
+            return QVariant();
+        }
+        return snapshot->values[it.value()];
+    });
+}
+
+
+QVariant SettingsCache::value(const QString& section, const QString& key) const
+{
+    return value(SettingsStore::path(section, key));
+}
+
+
+void SettingsCache::reclaim()
+{
+    quint64 oldest = std::numeric_limits<quint64>::max();
+    for (const auto& announced: _reader_epochs)
+    {
+        quint64 epoch = announced.load(std::memory_order_seq_cst);
+        if (epoch != 0)
+        {
+            oldest = std::min(oldest, epoch);
+        }
+    }
+
+    // readers without slot hold the mutex while reading
+    std::lock_guard<std::mutex> lock(_fallback_mutex);
+    auto end = std::remove_if(_retired.begin(), _retired.end(), [oldest](const Retired& retired) {
+        // a reader that announced an epoch up to the one of the replacement may have loaded the snapshot
+        if (retired.epoch >= oldest)
+        {
+            return false;
+        }
+        delete retired.snapshot;
+        return true;
+    });
+    _retired.erase(end, _retired.end());
+}
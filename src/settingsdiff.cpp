@@ -0,0 +1,257 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <QDebug>
+#include <QJsonDocument>
+#include <QSet>
+#include "settingsdiff.h"
+#include "settingitems.h"
+#include "settingsschema.h"
+#include "settingsstore.h"
+
+
+void SettingsDiff::addPanel(const QString& name, const QJsonArray& schema)
+{
+    _panels << name;
+    addSettings(_panels.size() - 1, SettingsSchema::expand(schema));
+}
+
+
+bool SettingsDiff::addPanel(const QString& name, const QString& filename)
+{
+    bool ok;
+    QJsonArray schema = SettingsSchema::load(filename, &ok);
+    if (!ok)
+    {
+        return false;
+    }
+    _panels << name;
+    addSettings(_panels.size() - 1, schema);
+    return true;
+}
+
+
+int SettingsDiff::compare(QSettings* left, QSettings* right, const Callback& callback) const
+{
+    struct Key
+    {
+        int panel;
+        QString path;
+    };
+
+    // only the keys are held, the values are read and compared one at a time
+    QSet<QString> paths;
+    for (const QString& key: left->allKeys())
+    {
+        paths.insert(settingPath(key));
+    }
+    for (const QString& key: right->allKeys())
+    {
+        paths.insert(settingPath(key));
+    }
+    std::vector<Key> keys;
+    keys.reserve(paths.size());
+    for (const QString& path: paths)
+    {
+        auto it = _settings.constFind(path);
+        Key key = {it == _settings.constEnd() ? int(_panels.size()) : it.value().panel, path};
+        keys.push_back(key);
+    }
+    paths.clear();
+    std::sort(keys.begin(), keys.end(), [](const Key& a, const Key& b) {
+        return a.panel != b.panel ? a.panel < b.panel : a.path < b.path;
+    });
+
+    int count = 0;
+    for (const Key& key: keys)
+    {
+        auto it = _settings.constFind(key.path);
+        const Setting* setting = it == _settings.constEnd() ? nullptr : &it.value();
+        Difference difference;
+        difference.left = read(left, key.path, setting);
+        difference.right = read(right, key.path, setting);
+        QJsonObject json = setting ? setting->json : QJsonObject();
+
+        if (difference.left.isValid() and difference.right.isValid())
+        {
+            if (equal(json, difference.left, difference.right))
+            {
+                continue;
+            }
+            difference.kind = Changed;
+        }
+        else if (difference.left.isValid() or difference.right.isValid())
+        {
+            QVariant value = difference.left.isValid() ? difference.left : difference.right;
+            QVariant default_value = json.value("default").toVariant();
+            if (setting and default_value.isValid() and SettingItemCreation::convertValue(json, default_value) and
+                equal(json, value, default_value))
+            {
+                difference.kind = DefaultEqual;
+            }
+            else
+            {
+                difference.kind = difference.left.isValid() ? OnlyLeft : OnlyRight;
+            }
+        }
+        else
+        {
+            continue;
+        }
+
+        difference.panel = setting ? _panels[setting->panel] : QString();
+        SettingsStore::splitPath(key.path, difference.section, difference.key);
+        difference.left_text = displayText(json, difference.left);
+        difference.right_text = displayText(json, difference.right);
+        callback(difference);
+        ++count;
+    }
+    return count;
+}
+
+
+QString SettingsDiff::kindName(Kind kind)
+{
+    switch(kind)
+    {
+        case Changed:
+            return "changed";
+        case OnlyLeft:
+            return "only left";
+        case OnlyRight:
+            return "only right";
+        case DefaultEqual:
+            return "default";
+    }
+    return QString();
+}
+
+
+void SettingsDiff::addSettings(int panel, const QJsonArray& schema)
+{
+    for (const QJsonValue& value: schema)
+    {
+        QJsonObject obj = value.toObject();
+        QString type = obj.value("type").toString();
+        if (type == "group")
+        {
+            addSettings(panel, obj.value("children").toArray());
+            continue;
+        }
+        if (type == "title" or type == "preset" or !obj.contains("key"))
+        {
+            continue;
+        }
+        QString path = SettingsStore::path(obj.value("section").toString(), obj.value("key").toString());
+        if (_settings.contains(path))
+        {
+            qWarning() << "Setting " << path << " is part of more than one panel - comparing it with the first";
+            continue;
+        }
+        Setting setting = {panel, obj};
+        _settings.insert(path, setting);
+    }
+}
+
+
+QString SettingsDiff::settingPath(const QString& key) const
+{
+    if (_settings.contains(key))
+    {
+        return key;
+    }
+    // settings with custom storage use several keys below their own, e.g. the rows of a table
+    int idx = key.lastIndexOf('/');
+    if (idx > 0)
+    {
+        auto it = _settings.constFind(key.left(idx));
+        if (it != _settings.constEnd() and SettingItemCreation::hasCustomStorage(it.value().json.value("type").toString()))
+        {
+            return it.key();
+        }
+    }
+    return key;
+}
+
+
+QVariant SettingsDiff::read(QSettings* settings, const QString& path, const Setting* setting) const
+{
+    if (!setting)
+    {
+        QString section, key;
+        SettingsStore::splitPath(path, section, key);
+        return SettingsStore::readValue(settings, section, key, QVariant());
+    }
+    QVariant value = SettingItemCreation::readValue(setting->json, settings);
+    QVariant converted = value;
+    // values that don't fit the type are compared as they are stored
+    return SettingItemCreation::convertValue(setting->json, converted) ? converted : value;
+}
+
+
+bool SettingsDiff::equal(const QJsonObject& json, const QVariant& left, const QVariant& right)
+{
+    if (json.value("type").toString() == "numeric")
+    {
+        bool left_ok, right_ok;
+        double left_number = left.toDouble(&left_ok);
+        double right_number = right.toDouble(&right_ok);
+        if (left_ok and right_ok)
+        {
+            // the spinbox rounds to the displayed decimals, values that round alike can't be told apart
+            double scale = std::pow(10.0, json.value("decimals").toInt(2));
+            return qRound64(left_number * scale) == qRound64(right_number * scale);
+        }
+    }
+    return left == right;
+}
+
+
+QString SettingsDiff::displayText(const QJsonObject& json, const QVariant& value)
+{
+    if (!value.isValid())
+    {
+        return QString();
+    }
+    QString type = json.value("type").toString();
+    if (type == "options")
+    {
+        QJsonObject options = json.value("options").toObject();
+        for (auto it = options.constBegin(); it != options.constEnd(); ++it)
+        {
+            if (it.value().toVariant() == value)
+            {
+                return it.key();
+            }
+        }
+    }
+    else if (type == "numeric")
+    {
+        return QString::number(value.toDouble(), 'f', json.value("decimals").toInt(2));
+    }
+    if (value.type() == QVariant::List or value.type() == QVariant::Map or value.type() == QVariant::StringList)
+    {
+        return QString::fromUtf8(QJsonDocument::fromVariant(value).toJson(QJsonDocument::Compact));
+    }
+    return value.toString();
+}
@@ -0,0 +1,143 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+#include "settingshelp.h"
+
+namespace
+{
+    /**
+     * @brief Descriptions from the schemas by full key
+     */
+    QHash<QString, QString> _descriptions;
+
+    /**
+     * @brief The help file documenting each setting by full key
+     */
+    QHash<QString, QString> _files;
+
+    /**
+     * @brief The texts of the help files that were read, by file
+     */
+    QHash<QString, QHash<QString, QString>> _texts;
+
+    QHash<QString, QString> loadFile(const QString& filename)
+    {
+        QHash<QString, QString> result;
+        QFile file(filename);
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            qWarning() << "Couldn't open help file " << filename;
+            return result;
+        }
+        QJsonParseError error;
+        QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+        if (!document.isObject())
+        {
+            qWarning() << "Help file " << filename << " does not contain a json object: " << error.errorString();
+            return result;
+        }
+        QJsonObject texts = document.object();
+        for (auto it = texts.constBegin(); it != texts.constEnd(); ++it)
+        {
+            if (!it.value().isArray())
+            {
+                result.insert(it.key(), it.value().toString());
+                continue;
+            }
+            QStringList paragraphs;
+            for (const QJsonValue& paragraph: it.value().toArray())
+            {
+                paragraphs << paragraph.toString();
+            }
+            result.insert(it.key(), paragraphs.join("\n\n"));
+        }
+        return result;
+    }
+}
+
+
+namespace SettingsHelp
+{
+    void setDescription(const QString& path, const QString& text)
+    {
+        if (text.isEmpty())
+        {
+            _descriptions.remove(path);
+        }
+        else
+        {
+            _descriptions.insert(path, text);
+        }
+    }
+
+    void addFile(const QString& filename, const QStringList& paths)
+    {
+        QString file = QFileInfo(filename).absoluteFilePath();
+        for (const QString& path: paths)
+        {
+            _files.insert(path, file);
+        }
+        // a file registered again may have changed
+        _texts.remove(file);
+    }
+
+    QString helpFileFor(const QString& schema_file)
+    {
+        QFileInfo info(schema_file);
+        return info.dir().filePath(info.completeBaseName() + ".help.json");
+    }
+
+    QString text(const QString& path)
+    {
+        auto description = _descriptions.constFind(path);
+        if (description != _descriptions.constEnd())
+        {
+            return description.value();
+        }
+        auto file = _files.constFind(path);
+        if (file == _files.constEnd())
+        {
+            return QString();
+        }
+        // only the file documenting the setting is read
+        auto texts = _texts.find(file.value());
+        if (texts == _texts.end())
+        {
+            texts = _texts.insert(file.value(), loadFile(file.value()));
+        }
+        return texts.value().value(path);
+    }
+
+    void clear()
+    {
+        _descriptions.clear();
+        _files.clear();
+        _texts.clear();
+    }
+}
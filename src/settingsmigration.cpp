@@ -0,0 +1,188 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <vector>
+#include <QDebug>
+#include <QHash>
+#include <QJsonArray>
+#include "settingsmigration.h"
+#include "settingsstore.h"
+
+namespace
+{
+    QHash<QString, SettingsMigration::Transform> _transforms;
+
+    const QString _version_section = "schema_version";
+
+    /**
+     * @brief The values changed by the steps so far, an invalid value for removed keys
+     */
+    typedef QHash<QString, QVariant> Changes;
+
+    /**
+     * @brief The value stored by the user, defaults, system values and session overrides are not migrated
+     */
+    QVariant userValue(QSettings* settings, const QString& path)
+    {
+        QString section, key;
+        SettingsStore::splitPath(path, section, key);
+        return SettingsStore::readUserValue(settings, section, key);
+    }
+
+    QVariant currentValue(const Changes& changes, QSettings* settings, const QString& path)
+    {
+        auto it = changes.constFind(path);
+        if (it != changes.constEnd())
+        {
+            return it.value();
+        }
+        return userValue(settings, path);
+    }
+
+    void move(Changes& changes, QSettings* settings, const QString& from, const QString& to)
+    {
+        QVariant value = currentValue(changes, settings, from);
+        if (!value.isValid())
+        {
+            return;
+        }
+        // a value that was already written under the new key wins
+        if (!currentValue(changes, settings, to).isValid())
+        {
+            changes[to] = value;
+        }
+        changes[from] = QVariant();
+    }
+
+    void transform(Changes& changes, QSettings* settings, const QString& path, const QJsonObject& step)
+    {
+        QVariant value = currentValue(changes, settings, path);
+        if (!value.isValid())
+        {
+            return;
+        }
+        if (step.contains("map"))
+        {
+            // ini files don't keep the type of the value, so the string representation is compared
+            QJsonObject map = step.value("map").toObject();
+            auto it = map.constFind(value.toString());
+            if (it != map.constEnd())
+            {
+                changes[path] = it.value().toVariant();
+            }
+            return;
+        }
+        QString name = step.value("function").toString();
+        auto it = _transforms.constFind(name);
+        if (it == _transforms.constEnd())
+        {
+            qWarning() << name << " is no registered transform - skipping migration of " << path;
+            return;
+        }
+        changes[path] = it.value()(value);
+    }
+}
+
+
+namespace SettingsMigration
+{
+    void registerTransform(QString name, Transform transform)
+    {
+        if (_transforms.contains(name))
+        {
+            qWarning() << name << " allready exists - not adding the new transform";
+            return;
+        }
+        _transforms[name] = transform;
+    }
+
+    int storedVersion(const QString& name, QSettings* settings)
+    {
+        return userValue(settings, SettingsStore::path(_version_section, name)).toInt();
+    }
+
+    int migrate(const QJsonObject& migrations, QSettings* settings)
+    {
+        QString name = migrations.value("name").toString("default");
+        std::vector<QJsonObject> steps;
+        int latest = 0;
+        for (const QJsonValue& value: migrations.value("steps").toArray())
+        {
+            QJsonObject step = value.toObject();
+            latest = qMax(latest, step.value("version").toInt());
+            steps.push_back(step);
+        }
+        // the common case after the first start with a schema version
+        int version = storedVersion(name, settings);
+        if (version >= latest)
+        {
+            return 0;
+        }
+
+        std::stable_sort(steps.begin(), steps.end(), [](const QJsonObject& a, const QJsonObject& b) {
+            return a.value("version").toInt() < b.value("version").toInt();
+        });
+        Changes changes;
+        int applied = 0;
+        for (const QJsonObject& step: steps)
+        {
+            if (step.value("version").toInt() <= version)
+            {
+                continue;
+            }
+            if (step.contains("move") or step.contains("rename"))
+            {
+                QString from = step.value(step.contains("move") ? "move" : "rename").toString();
+                move(changes, settings, from, step.value("to").toString());
+            }
+            else if (step.contains("transform"))
+            {
+                transform(changes, settings, step.value("transform").toString(), step);
+            }
+            else
+            {
+                qWarning() << "Unknown migration step " << step << " - skipping it";
+                continue;
+            }
+            ++applied;
+        }
+
+        // one batch for all steps, written together with the new version
+        QVariantHash values;
+        for (auto it = changes.constBegin(); it != changes.constEnd(); ++it)
+        {
+            if (it.value().isValid())
+            {
+                values.insert(it.key(), it.value());
+            }
+            else
+            {
+                QString section, key;
+                SettingsStore::splitPath(it.key(), section, key);
+                SettingsStore::removeValue(settings, section, key);
+            }
+        }
+        values.insert(SettingsStore::path(_version_section, name), latest);
+        SettingsStore::writeValues(settings, values);
+        SettingsStore::syncSettings(settings);
+        return applied;
+    }
+}
@@ -19,6 +19,9 @@
  */
 
 #include "settingspanel.h"
+#include "settingsmigration.h"
+#include "settingshelp.h"
+#include "settingliteitem.h"
 
 
 SettingsPanel::SettingsPanel(QSettings* settings, QWidget* parent) : QScrollArea(parent), _settings(settings)
@@ -32,10 +35,15 @@ SettingsPanel::SettingsPanel(QSettings* settings, QWidget* parent) : QScrollArea
 }
 
 
-SettingsPanel* SettingsPanel::fromJson(QJsonArray json, QSettings* settings, QWidget* parent)
+SettingsPanel* SettingsPanel::fromJson(QJsonArray json, QSettings* settings, QWidget* parent, bool progressive,
+                                       bool lite)
 {
     auto panel = new SettingsPanel(settings, parent);
+    panel->setLiteItems(lite);
     // extract info from the json array
+    // conditions may reference settings further down, so all entries are added before any is constructed
+    panel->_building = true;
+    json = SettingsSchema::expand(json);
     for(auto obj_ref : json)
     {
         if(!obj_ref.isObject())
@@ -43,56 +51,1231 @@ SettingsPanel* SettingsPanel::fromJson(QJsonArray json, QSettings* settings, QWi
             qWarning() << "Json array does not contain json objects - skipping ...";
             continue;
         }
-        QJsonObject obj = obj_ref.toObject();
+        panel->addJsonItem(obj_ref.toObject());
+    }
+    panel->_building = false;
+
+    for(int i=0; i<int(panel->_entries.size()); ++i)
+    {
+        panel->resolveVisibility(i);
+    }
+    if(progressive)
+    {
+        panel->startProgressiveConstruction();
+        return panel;
+    }
+    for(int i=0; i<int(panel->_entries.size()); ++i)
+    {
+        if(panel->isShown(i))
+        {
+            panel->construct(i);
+        }
+    }
+    return panel;
+}
+
+
+void SettingsPanel::setLiteItems(bool lite)
+{
+    _lite = lite;
+}
+
+
+void SettingsPanel::addSettingItem(SettingItem* item)
+{
+    Entry entry;
+    entry.path = SettingsStore::path(item->section(), item->key());
+    entry.widget = item;
+    entry.item = item;
+    entry.resolved = true;
+    int idx = addEntry(entry);
+    insertWidget(idx, item);
+    connectItem(idx);
+    updateDependents(_entries[idx].path);
+}
+
+
+void SettingsPanel::addTitle(QString title)
+{
+    Entry entry;
+    entry.widget = createTitle(title);
+    entry.resolved = true;
+    int idx = addEntry(entry);
+    insertWidget(idx, _entries[idx].widget);
+}
+
+
+void SettingsPanel::addJsonItem(QJsonObject obj)
+{
+    int first = int(_entries.size());
+    addJsonEntry(obj, -1);
+    if(_building)
+    {
+        return;
+    }
+
+    // a group brings its children along, all of them are resolved before any is constructed
+    for(int i=first; i<int(_entries.size()); ++i)
+    {
+        resolveVisibility(i);
+    }
+    for(int i=first; i<int(_entries.size()); ++i)
+    {
+        applyVisibility(i);
+        updateDependents(_entries[i].path);
+    }
+}
+
+
+void SettingsPanel::addJsonEntry(const QJsonObject& obj, int parent)
+{
+    QString type = obj.value("type").toString();
+    // presets are no widgets
+    if(type == "preset")
+    {
+        QVariantHash& preset = _presets[obj.value("name").toString()];
+        QJsonObject values = obj.value("values").toObject();
+        for(auto it = values.begin(); it != values.end(); ++it)
+        {
+            preset.insert(it.key(), it.value().toVariant());
+        }
+        return;
+    }
+    // stored values have to be up to date before any item reads them
+    if(type == "migrations")
+    {
+        SettingsMigration::migrate(obj, _settings);
+        return;
+    }
+
+    Entry entry;
+    if(type == "group")
+    {
+        entry.group = true;
+        entry.expanded = obj.value("expanded").toBool(false);
+    }
+    else if(type != "title")
+    {
+        entry.path = SettingsStore::path(obj.value("section").toString(), obj.value("key").toString());
+    }
+    if(obj.contains("visible_if"))
+    {
+        entry.visible_if = SettingCondition::parse(obj.value("visible_if").toString());
+    }
+    if(obj.contains("enabled_if"))
+    {
+        entry.enabled_if = SettingCondition::parse(obj.value("enabled_if").toString());
+    }
+    // descriptions are looked up by key when a tooltip is shown, the entry doesn't keep them
+    QJsonObject json = obj;
+    if(!entry.path.isEmpty())
+    {
+        SettingsHelp::setDescription(entry.path, json.take("desc").toString());
+    }
+    if(entry.group)
+    {
+        // the children are entries of their own
+        json.remove("children");
+    }
+    entry.json = json;
+    entry.parent = parent;
+    int idx = addEntry(entry);
+    if(!entry.group)
+    {
+        return;
+    }
+
+    // the entries may be reallocated while the children are added, so only the index is kept
+    for(auto child_ref : obj.value("children").toArray())
+    {
+        if(!child_ref.isObject())
+        {
+            qWarning() << "Children of group " << obj.value("title").toString() << " contain no json objects - skipping ...";
+            continue;
+        }
+        addJsonEntry(child_ref.toObject(), idx);
+    }
+    _entries[idx].end = int(_entries.size());
+}
+
+
+void SettingsPanel::updateFromJson(QJsonArray json)
+{
+    finishConstruction();
+    int scroll_position = verticalScrollBar()->value();
+    bool was_dirty = isDirty();
+    widget()->setUpdatesEnabled(false);
+
+    // build the new model, widgets of unchanged entries are taken over afterwards
+    std::vector<Entry> old_entries;
+    old_entries.swap(_entries);
+    QSet<int> old_dirty = _dirty;
+    _dirty.clear();
+    _index.clear();
+    _dependents.clear();
+    _presets.clear();
+    _last_constructed = -1;
+    _building = true;
+    json = SettingsSchema::expand(json);
+    for(auto obj_ref : json)
+    {
+        if(!obj_ref.isObject())
+        {
+            qWarning() << "Json array does not contain json objects - skipping ...";
+            continue;
+        }
+        addJsonEntry(obj_ref.toObject(), -1);
+    }
+    _building = false;
+
+    // the layouts are rebuilt, so removed groups can't take reused children with them
+    for(Entry& entry: old_entries)
+    {
+        if(entry.widget)
+        {
+            QWidget* parent = entry.widget->parentWidget();
+            if(parent and parent->layout())
+            {
+                parent->layout()->removeWidget(entry.widget);
+            }
+            entry.widget->setParent(widget());
+        }
+    }
+
+    QStringList old_keys = entryKeys(old_entries);
+    QHash<QString, int> old_index;
+    for(int i=0; i<old_keys.size(); ++i)
+    {
+        old_index.insert(old_keys[i], i);
+    }
+    QStringList keys = entryKeys(_entries);
+    for(int i=0; i<int(_entries.size()); ++i)
+    {
+        auto old_idx = old_index.constFind(keys[i]);
+        if(old_idx == old_index.constEnd())
+        {
+            continue;
+        }
+        Entry& old_entry = old_entries[old_idx.value()];
+        Entry& entry = _entries[i];
+        bool dirty = old_dirty.contains(old_idx.value());
+        if(entry.group)
+        {
+            entry.expanded = old_entry.expanded;
+        }
+        if(sameDescription(old_entry, entry))
+        {
+            entry.widget = old_entry.widget;
+            entry.item = old_entry.item;
+            entry.container = old_entry.container;
+            entry.pending = old_entry.pending;
+            entry.failed = old_entry.failed;
+            old_entry.widget = nullptr;
+            if(entry.item)
+            {
+                disconnect(entry.item, &SettingItem::valueChanged, this, nullptr);
+                connectItem(i);
+            }
+            if(entry.group and entry.widget)
+            {
+                connectGroup(i);
+            }
+        }
+        else if(dirty and !entry.path.isEmpty())
+        {
+            // the description changed, unsaved edits are kept if they are still valid
+            QVariant value = old_entry.item ? old_entry.item->value() : old_entry.pending;
+            if(value.isValid() and SettingItemCreation::convertValue(entry.json, value))
+            {
+                entry.pending = value;
+            }
+        }
+        if(dirty and (entry.item or entry.pending.isValid()))
+        {
+            _dirty.insert(i);
+        }
+    }
+
+    // widgets that were not taken over
+    for(Entry& entry: old_entries)
+    {
+        delete entry.widget;
+    }
+
+    for(int i=0; i<int(_entries.size()); ++i)
+    {
+        Entry& entry = _entries[i];
+        if(!entry.widget)
+        {
+            continue;
+        }
+        if(entry.parent >= 0 and !_entries[entry.parent].container)
+        {
+            // moved into a group that isn't constructed, the value waits for the group
+            if(entry.item and _dirty.contains(i))
+            {
+                entry.pending = entry.item->value();
+            }
+            delete entry.widget;
+            entry.widget = nullptr;
+            entry.item = nullptr;
+            entry.container = nullptr;
+            continue;
+        }
+        insertWidget(i, entry.widget);
+    }
+
+    for(int i=0; i<int(_entries.size()); ++i)
+    {
+        resolveVisibility(i);
+    }
+    for(int i=0; i<int(_entries.size()); ++i)
+    {
+        applyVisibility(i);
+        applyEnabled(i);
+    }
+    widget()->setUpdatesEnabled(true);
+
+    // the scroll range is only updated once the layout is done
+    verticalScrollBar()->setValue(scroll_position);
+    QTimer::singleShot(0, this, [this, scroll_position]() {
+        verticalScrollBar()->setValue(scroll_position);
+    });
+    if(was_dirty != isDirty())
+    {
+        emit dirtyChanged(isDirty());
+    }
+}
+
+
+void SettingsPanel::restoreDefaults()
+{
+    bool was_dirty = isDirty();
+    QStringList changed;
+    widget()->setUpdatesEnabled(false);
+    for(int i=0; i<int(_entries.size()); ++i)
+    {
+        Entry& entry = _entries[i];
+        if(entry.item)
+        {
+            QSignalBlocker blocker(entry.item);
+            entry.item->restoreDefault();
+        }
+        else if(!entry.json.isEmpty() and !entry.path.isEmpty())
+        {
+            entry.pending = defaultValue(entry);
+        }
+        else
+        {
+            continue;
+        }
+        _dirty.insert(i);
+        changed << entry.path;
+    }
+    finishBatch(changed, was_dirty);
+    widget()->setUpdatesEnabled(true);
+}
+
+
+void SettingsPanel::saveSettings()
+{
+    // settings that were never constructed still have their stored value unless a value is pending
+    for(auto& entry: _entries)
+    {
+        if(entry.item)
+        {
+            entry.item->saveSetting();
+        }
+        else if(entry.pending.isValid())
+        {
+            SettingItemCreation::writeValue(entry.json, _settings, entry.pending);
+            entry.pending = QVariant();
+        }
+    }
+    clearDirty();
+}
+
+
+void SettingsPanel::reloadSettings()
+{
+    for(auto& entry: _entries)
+    {
+        entry.pending = QVariant();
+        if(entry.item)
+        {
+            entry.item->reload();
+        }
+    }
+    clearDirty();
+}
+
+
+int SettingsPanel::applyValues(const QVariantHash& values)
+{
+    bool was_dirty = isDirty();
+    QStringList changed;
+    // one repaint and one dependency update for the whole batch instead of one per item
+    widget()->setUpdatesEnabled(false);
+    for(auto it = values.constBegin(); it != values.constEnd(); ++it)
+    {
+        auto idx = _index.constFind(it.key());
+        if(idx == _index.constEnd())
+        {
+            continue;
+        }
+        QVariant value = it.value();
+        if(!convertValue(it.key(), value))
+        {
+            qWarning() << "Invalid value " << value << " for " << it.key() << " - skipping it";
+            continue;
+        }
+
+        Entry& entry = _entries[idx.value()];
+        if(entry.item)
+        {
+            QSignalBlocker blocker(entry.item);
+            entry.item->setValue(value);
+        }
+        else
+        {
+            entry.pending = value;
+        }
+        _dirty.insert(idx.value());
+        changed << it.key();
+    }
+    finishBatch(changed, was_dirty);
+    widget()->setUpdatesEnabled(true);
+    return changed.size();
+}
+
+
+void SettingsPanel::collectCurrentValues(QVariantHash& values) const
+{
+    for(const Entry& entry: _entries)
+    {
+        if(entry.path.isEmpty())
+        {
+            continue;
+        }
+        QVariant value = currentValue(entry);
+        if(value.isValid())
+        {
+            values.insert(entry.path, value);
+        }
+    }
+}
+
+
+SettingsPanel::Snapshot SettingsPanel::snapshot() const
+{
+    Snapshot snapshot;
+    snapshot.generation = _generation;
+    snapshot.values.reserve(_entries.size());
+    for(const Entry& entry: _entries)
+    {
+        snapshot.values.push_back(entry.path.isEmpty() ? QVariant() : currentValue(entry));
+    }
+    return snapshot;
+}
+
+
+bool SettingsPanel::applySnapshot(Snapshot snapshot)
+{
+    if(snapshot.generation != _generation or snapshot.values.size() != _entries.size())
+    {
+        qWarning() << "Snapshot doesn't match the settings of the panel - not applying it";
+        return false;
+    }
+
+    bool was_dirty = isDirty();
+    QStringList changed;
+    widget()->setUpdatesEnabled(false);
+    for(int i=0; i<int(_entries.size()); ++i)
+    {
+        Entry& entry = _entries[i];
+        QVariant& value = snapshot.values[i];
+        if(!value.isValid() or value == currentValue(entry))
+        {
+            continue;
+        }
+        if(entry.item)
+        {
+            QSignalBlocker blocker(entry.item);
+            entry.item->setValue(value);
+        }
+        else
+        {
+            entry.pending = std::move(value);
+        }
+        _dirty.insert(i);
+        changed << entry.path;
+    }
+    finishBatch(changed, was_dirty);
+    widget()->setUpdatesEnabled(true);
+    return true;
+}
+
+
+QHash<QString, QVariantHash> SettingsPanel::presets() const
+{
+    return _presets;
+}
+
+
+bool SettingsPanel::isDirty() const
+{
+    return !_dirty.isEmpty();
+}
+
+
+QStringList SettingsPanel::settingPaths() const
+{
+    return _index.keys();
+}
+
+
+QVariant SettingsPanel::savedValue(const QString& path) const
+{
+    auto it = _index.find(path);
+    if(it == _index.end())
+    {
+        return QVariant();
+    }
+    const Entry& entry = _entries[it.value()];
+    QVariant value = storedValue(entry);
+    return value.isValid() ? value : defaultValue(entry);
+}
+
+
+void SettingsPanel::collectChangedValues(QVariantHash& values) const
+{
+    for(const Entry& entry: _entries)
+    {
+        // only what the user changed, values of the system layer and session overrides aren't exported
+        QVariant value = storedValue(entry, true);
+        if(value.isValid() and value != defaultValue(entry))
+        {
+            values.insert(entry.path, value);
+        }
+    }
+}
+
+
+void SettingsPanel::collectValues(QVariantHash& values) const
+{
+    for(const Entry& entry: _entries)
+    {
+        if(entry.path.isEmpty())
+        {
+            continue;
+        }
+        QVariant value = storedValue(entry);
+        if(!value.isValid())
+        {
+            value = defaultValue(entry);
+        }
+        if(value.isValid())
+        {
+            values.insert(entry.path, value);
+        }
+    }
+}
+
+
+void SettingsPanel::writeValues(const QVariantHash& values)
+{
+    QVariantHash plain_values;
+    plain_values.reserve(values.size());
+    for(auto it = values.constBegin(); it != values.constEnd(); ++it)
+    {
+        auto idx = _index.find(it.key());
+        if(idx == _index.end())
+        {
+            continue;
+        }
+        const Entry& entry = _entries[idx.value()];
+        if(!entry.json.isEmpty() and SettingItemCreation::hasCustomStorage(entry.json.value("type").toString()))
+        {
+            SettingItemCreation::writeValue(entry.json, _settings, it.value());
+        }
+        else
+        {
+            plain_values.insert(it.key(), it.value());
+        }
+    }
+    SettingsStore::writeValues(_settings, plain_values);
+}
+
+
+bool SettingsPanel::convertValue(const QString& path, QVariant& value) const
+{
+    auto it = _index.find(path);
+    if(it == _index.end())
+    {
+        return false;
+    }
+
+    const Entry& entry = _entries[it.value()];
+    if(!entry.json.isEmpty())
+    {
+        return SettingItemCreation::convertValue(entry.json, value);
+    }
+    // items added via code are checked against the type of their default value
+    QVariant default_value = entry.item ? entry.item->defaultValue() : QVariant();
+    if(!default_value.isValid())
+    {
+        return value.isValid();
+    }
+    return value.convert(default_value.userType());
+}
+
+
+bool SettingsPanel::isConstructing() const
+{
+    return _next_construct >= 0;
+}
+
+
+void SettingsPanel::finishConstruction()
+{
+    if(!isConstructing())
+    {
+        return;
+    }
+    _construction_timer->stop();
+    for(int i=_next_construct; i<int(_entries.size()); ++i)
+    {
+        if(isShown(i))
+        {
+            construct(i);
+        }
+    }
+    _next_construct = -1;
+    emit constructionProgress(int(_entries.size()), int(_entries.size()));
+    emit constructionFinished();
+}
+
+
+int SettingsPanel::constructedCount() const
+{
+    int count = 0;
+    for(const Entry& entry: _entries)
+    {
+        if(entry.widget)
+        {
+            ++count;
+        }
+    }
+    return count;
+}
+
+
+qint64 SettingsPanel::estimatedWidgetMemory() const
+{
+    // a QWidget with its private data, palette and font is about 2 KiB, the item objects are small in comparison
+    const qint64 widget_size = 2048;
+    qint64 size = 0;
+    for(const Entry& entry: _entries)
+    {
+        if(entry.widget and (entry.parent < 0 or !_entries[entry.parent].widget))
+        {
+            // the widgets of children are counted with their group
+            size += widget_size * (1 + entry.widget->findChildren<QWidget*>().size());
+        }
+    }
+    return size;
+}
+
+
+int SettingsPanel::evictWidgets()
+{
+    if(isConstructing())
+    {
+        return 0;
+    }
 
-        // sort out titles
-        if(obj["type"].toString() == "title")
+    int evicted = 0;
+    widget()->setUpdatesEnabled(false);
+    // children are destroyed before their groups, which would take them along
+    for(int i=int(_entries.size())-1; i>=0; --i)
+    {
+        Entry& entry = _entries[i];
+        if(!entry.widget or entry.json.isEmpty())
         {
-            panel->addTitle(obj["title"].toString());
+            continue;
         }
-        else
+        if(entry.item and _dirty.contains(i))
+        {
+            entry.pending = entry.item->value();
+        }
+        delete entry.widget;
+        entry.widget = nullptr;
+        entry.item = nullptr;
+        entry.container = nullptr;
+        ++evicted;
+    }
+
+    _last_constructed = -1;
+    for(int i=0; i<int(_entries.size()); ++i)
+    {
+        if(_entries[i].widget and _entries[i].parent < 0)
         {
-            auto new_item = SettingItemCreation::createItemfromJson(obj, settings, panel);
-            if(!new_item)
+            _last_constructed = i;
+        }
+    }
+    _evicted = true;
+    widget()->setUpdatesEnabled(true);
+    return evicted;
+}
+
+
+void SettingsPanel::showEvent(QShowEvent* event)
+{
+    if(_evicted)
+    {
+        _evicted = false;
+        widget()->setUpdatesEnabled(false);
+        for(int i=0; i<int(_entries.size()); ++i)
+        {
+            if(isShown(i))
             {
-                qWarning() << "SettingItemCreation for type " << obj["type"].toString() << " failed.";
-                continue;
+                construct(i);
             }
-            panel->addSettingItem(new_item);
         }
+        widget()->setUpdatesEnabled(true);
     }
-    return panel;
+    QScrollArea::showEvent(event);
 }
 
 
-void SettingsPanel::addSettingItem(SettingItem* item)
+void SettingsPanel::setConstructionBudget(int msec)
 {
-    _items.push_back(item);
-    widget()->layout()->addWidget(item);
+    _construction_budget = qMax(1, msec);
 }
 
 
-void SettingsPanel::addTitle(QString title)
+QLabel* SettingsPanel::createTitle(QString title)
 {
     QLabel* label = new QLabel("<b>" + title + "<b/>", this);
     label->setAlignment(Qt::AlignCenter);
-    widget()->layout()->addWidget(label);
+    return label;
 }
 
 
-void SettingsPanel::restoreDefaults()
+QWidget* SettingsPanel::createGroup(int idx)
+{
+    Entry& entry = _entries[idx];
+    QWidget* group = new QWidget(this);
+    auto layout = new QVBoxLayout(group);
+    layout->setContentsMargins(0, 0, 0, 0);
+
+    QToolButton* header = new QToolButton(group);
+    header->setText(entry.json.value("title").toString());
+    header->setToolButtonStyle(Qt::ToolButtonTextBesideIcon);
+    header->setArrowType(entry.expanded ? Qt::DownArrow : Qt::RightArrow);
+    header->setAutoRaise(true);
+    header->setCheckable(true);
+    header->setChecked(entry.expanded);
+    QFont font = header->font();
+    font.setBold(true);
+    header->setFont(font);
+    layout->addWidget(header);
+
+    entry.container = new QWidget(group);
+    auto container_layout = new QVBoxLayout(entry.container);
+    container_layout->setContentsMargins(16, 0, 0, 0);
+    entry.container->setVisible(entry.expanded);
+    layout->addWidget(entry.container);
+
+    return group;
+}
+
+
+void SettingsPanel::connectGroup(int idx)
+{
+    QToolButton* header = _entries[idx].widget->findChild<QToolButton*>(QString(), Qt::FindDirectChildrenOnly);
+    // the index changes when the panel is updated from a changed description
+    disconnect(header, nullptr, this, nullptr);
+    connect(header, &QToolButton::toggled, this, [this, idx, header](bool checked) {
+        header->setArrowType(checked ? Qt::DownArrow : Qt::RightArrow);
+        setExpanded(idx, checked);
+    });
+}
+
+
+QStringList SettingsPanel::entryKeys(const std::vector<Entry>& entries)
+{
+    QStringList keys;
+    QHash<QString, int> occurrences;
+    for(const Entry& entry: entries)
+    {
+        QString key = entry.path;
+        if(key.isEmpty())
+        {
+            key = entry.json.value("type").toString() + ":" + entry.json.value("title").toString();
+        }
+        // repeated titles are told apart by their order
+        int occurrence = occurrences[key]++;
+        keys << (occurrence == 0 ? key : key + "#" + QString::number(occurrence));
+    }
+    return keys;
+}
+
+
+bool SettingsPanel::sameDescription(const Entry& a, const Entry& b)
 {
-    for(auto item: _items)
+    if(!a.group or !b.group)
     {
-        item->restoreDefault();
+        return a.json == b.json;
     }
+    // a changed child must not recreate the group with all its other children
+    QJsonObject a_json = a.json;
+    QJsonObject b_json = b.json;
+    a_json.remove("children");
+    b_json.remove("children");
+    return a_json == b_json;
 }
 
 
-void SettingsPanel::saveSettings()
+QVariant SettingsPanel::storedValue(const Entry& entry, bool user_only) const
+{
+    if(entry.path.isEmpty() or (entry.json.isEmpty() and !entry.item))
+    {
+        return QVariant();
+    }
+
+    QVariant value;
+    if(entry.json.isEmpty())
+    {
+        QString section, key;
+        SettingsStore::splitPath(entry.path, section, key);
+        value = user_only ? SettingsStore::readUserValue(_settings, section, key)
+                          : SettingsStore::readValue(_settings, section, key, QVariant());
+    }
+    else
+    {
+        value = user_only ? SettingItemCreation::readUserValue(entry.json, _settings)
+                          : SettingItemCreation::readValue(entry.json, _settings);
+    }
+    if(!value.isValid() or !convertValue(entry.path, value))
+    {
+        return QVariant();
+    }
+    return value;
+}
+
+
+QVariant SettingsPanel::currentValue(const Entry& entry) const
+{
+    if(entry.item)
+    {
+        return entry.item->value();
+    }
+    if(entry.pending.isValid())
+    {
+        return entry.pending;
+    }
+    QVariant value = storedValue(entry);
+    return value.isValid() ? value : defaultValue(entry);
+}
+
+
+QVariant SettingsPanel::defaultValue(const Entry& entry) const
+{
+    if(entry.json.isEmpty())
+    {
+        return entry.item ? entry.item->defaultValue() : QVariant();
+    }
+    return SettingItemCreation::defaultValue(entry.json);
+}
+
+
+int SettingsPanel::addEntry(Entry entry)
+{
+    int idx = int(_entries.size());
+    ++_generation;
+    if(!entry.path.isEmpty())
+    {
+        if(_index.contains(entry.path))
+        {
+            qWarning() << "Setting " << entry.path << " is added to the panel more than once";
+        }
+        _index[entry.path] = idx;
+    }
+
+    QStringList references = entry.visible_if.references() + entry.enabled_if.references();
+    for(const QString& reference: references)
+    {
+        QVector<int>& dependents = _dependents[reference];
+        if(dependents.isEmpty() or dependents.last() != idx)
+        {
+            dependents.append(idx);
+        }
+    }
+
+    _entries.push_back(std::move(entry));
+    return idx;
+}
+
+
+bool SettingsPanel::resolveVisibility(int idx)
+{
+    if(_entries[idx].resolved)
+    {
+        return _entries[idx].visible;
+    }
+    if(_entries[idx].resolving)
+    {
+        qWarning() << "Cyclic visible_if condition for " << _entries[idx].path << " - showing it";
+        return true;
+    }
+
+    _entries[idx].resolving = true;
+    bool visible = _entries[idx].visible_if.evaluate([this](const QString& path) { return conditionValue(path); });
+
+    Entry& entry = _entries[idx];
+    entry.resolving = false;
+    entry.resolved = true;
+    entry.visible = visible;
+    return visible;
+}
+
+
+void SettingsPanel::applyVisibility(int idx)
+{
+    Entry& entry = _entries[idx];
+    if(!entry.visible)
+    {
+        if(entry.widget)
+        {
+            entry.widget->hide();
+        }
+    }
+    else if(!entry.widget)
+    {
+        if(_evicted or !isShown(idx))
+        {
+            // inside a collapsed or hidden group or evicted, constructed when it is shown
+            return;
+        }
+        construct(idx);
+        if(entry.group and entry.expanded)
+        {
+            constructChildren(idx);
+        }
+    }
+    else
+    {
+        entry.widget->show();
+    }
+}
+
+
+bool SettingsPanel::isShown(int idx) const
+{
+    for(; idx >= 0; idx = _entries[idx].parent)
+    {
+        const Entry& entry = _entries[idx];
+        if(!entry.visible or (entry.parent >= 0 and !_entries[entry.parent].expanded))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void SettingsPanel::setExpanded(int idx, bool expanded)
+{
+    Entry& entry = _entries[idx];
+    if(entry.expanded == expanded)
+    {
+        return;
+    }
+    entry.expanded = expanded;
+    // collapsing only hides the children, their widgets keep unsaved changes
+    entry.container->setVisible(expanded);
+    if(expanded)
+    {
+        constructChildren(idx);
+    }
+}
+
+
+void SettingsPanel::constructChildren(int idx)
+{
+    // nested groups come before their children, so a single pass constructs expanded subgroups as well
+    int end = _entries[idx].end;
+    for(int i=idx+1; i<end; ++i)
+    {
+        if(isShown(i))
+        {
+            construct(i);
+        }
+    }
+}
+
+
+void SettingsPanel::applyEnabled(int idx)
+{
+    Entry& entry = _entries[idx];
+    if(entry.widget and !entry.enabled_if.isNull())
+    {
+        entry.widget->setEnabled(entry.enabled_if.evaluate([this](const QString& path) { return conditionValue(path); }));
+    }
+}
+
+
+void SettingsPanel::construct(int idx)
+{
+    Entry& entry = _entries[idx];
+    if(entry.widget or entry.failed)
+    {
+        return;
+    }
+    if(entry.parent >= 0 and !_entries[entry.parent].container)
+    {
+        // constructed together with the group
+        return;
+    }
+
+    // sort out titles and groups
+    if(entry.json.value("type").toString() == "title")
+    {
+        entry.widget = createTitle(entry.json.value("title").toString());
+    }
+    else if(entry.group)
+    {
+        entry.widget = createGroup(idx);
+        connectGroup(idx);
+    }
+    else
+    {
+        if(_lite)
+        {
+            entry.item = SettingLiteItem::fromJsonObject(entry.json, _settings, this);
+        }
+        else
+        {
+            entry.item = SettingItemCreation::createItemfromJson(entry.json, _settings, this);
+        }
+        if(!entry.item)
+        {
+            qWarning() << "SettingItemCreation for type " << entry.json.value("type").toString() << " failed.";
+            entry.failed = true;
+            return;
+        }
+        entry.widget = entry.item;
+    }
+
+    insertWidget(idx, entry.widget);
+    if(entry.item)
+    {
+        if(entry.pending.isValid())
+        {
+            entry.item->setValue(entry.pending);
+            entry.pending = QVariant();
+        }
+        connectItem(idx);
+    }
+    applyEnabled(idx);
+}
+
+
+void SettingsPanel::startProgressiveConstruction()
+{
+    _construction_timer = new QTimer(this);
+    _construction_timer->setInterval(0);
+    connect(_construction_timer, &QTimer::timeout, this, &SettingsPanel::constructSlice);
+
+    // the panel is usually not laid out yet, so the screen height is the best guess for the first screenful
+    int first_screen = viewport()->height();
+    if(!isVisible())
+    {
+        QScreen* screen = QGuiApplication::primaryScreen();
+        first_screen = screen ? screen->availableGeometry().height() : 600;
+    }
+
+    int height = 0;
+    int idx = 0;
+    for(; idx<int(_entries.size()) and height<first_screen; ++idx)
+    {
+        if(!isShown(idx))
+        {
+            continue;
+        }
+        construct(idx);
+        if(_entries[idx].widget)
+        {
+            height += _entries[idx].widget->sizeHint().height();
+        }
+    }
+
+    // progress is reported from the first slice, after the caller of fromJson connected to the signals
+    _next_construct = idx;
+    _construction_timer->start();
+}
+
+
+void SettingsPanel::constructSlice()
+{
+    QElapsedTimer timer;
+    timer.start();
+    int idx = _next_construct;
+    while(idx < int(_entries.size()) and timer.elapsed() < _construction_budget)
+    {
+        if(isShown(idx))
+        {
+            construct(idx);
+        }
+        ++idx;
+    }
+
+    emit constructionProgress(idx, int(_entries.size()));
+    if(idx < int(_entries.size()))
+    {
+        _next_construct = idx;
+        return;
+    }
+    _construction_timer->stop();
+    _next_construct = -1;
+    emit constructionFinished();
+}
+
+
+void SettingsPanel::insertWidget(int idx, QWidget* new_widget)
+{
+    int parent = _entries[idx].parent;
+    QWidget* container = parent < 0 ? widget() : _entries[parent].container;
+    auto layout = static_cast<QVBoxLayout*>(container->layout());
+    if(parent < 0 and idx > _last_constructed)
+    {
+        // no constructed entry follows, so appending keeps the order
+        layout->addWidget(new_widget);
+        _last_constructed = idx;
+        return;
+    }
+
+    // the widget goes behind the closest constructed sibling before it
+    int pos = 0;
+    for(int i=idx-1; i>parent; --i)
+    {
+        if(_entries[i].parent == parent and _entries[i].widget)
+        {
+            pos = layout->indexOf(_entries[i].widget) + 1;
+            break;
+        }
+    }
+    layout->insertWidget(pos, new_widget);
+}
+
+
+QVariant SettingsPanel::conditionValue(const QString& path)
+{
+    QString section, key;
+    SettingsStore::splitPath(path, section, key);
+
+    auto it = _index.find(path);
+    if(it == _index.end())
+    {
+        // settings of other panels only contribute their saved value
+        return SettingsStore::readValue(_settings, section, key, QVariant());
+    }
+
+    int idx = it.value();
+    if(!resolveVisibility(idx))
+    {
+        // hidden settings count as unset
+        return QVariant();
+    }
+    const Entry& entry = _entries[idx];
+    if(entry.item)
+    {
+        return entry.item->value();
+    }
+    return SettingsStore::readValue(_settings, section, key, entry.json.value("default").toVariant());
+}
+
+
+void SettingsPanel::updateDependents(const QString& path)
+{
+    if(!_dependents.contains(path))
+    {
+        return;
+    }
+    updateDependents(QStringList() << path);
+}
+
+
+void SettingsPanel::updateDependents(const QStringList& paths)
+{
+    auto resolver = [this](const QString& reference) { return conditionValue(reference); };
+    QStringList changed = paths;
+    // visibility changes cascade downstream, bound the work in case of cyclic conditions
+    int budget = 4 * int(_entries.size() + paths.size());
+    while(!changed.isEmpty())
+    {
+        QString current = changed.takeFirst();
+        for(int idx: _dependents.value(current))
+        {
+            if(--budget < 0)
+            {
+                qWarning() << "Cyclic conditions detected while updating dependents of " << paths;
+                return;
+            }
+            Entry& entry = _entries[idx];
+            bool visible = entry.visible_if.evaluate(resolver);
+            if(visible != entry.visible)
+            {
+                entry.visible = visible;
+                applyVisibility(idx);
+                if(!entry.path.isEmpty())
+                {
+                    changed << entry.path;
+                }
+            }
+            applyEnabled(idx);
+        }
+    }
+}
+
+
+void SettingsPanel::connectItem(int idx)
+{
+    QString path = _entries[idx].path;
+    connect(_entries[idx].item, &SettingItem::valueChanged, this, [this, idx, path]() {
+        markDirty(idx);
+        updateDependents(path);
+    });
+}
+
+
+void SettingsPanel::markDirty(int idx)
+{
+    bool was_dirty = isDirty();
+    _dirty.insert(idx);
+    if(!was_dirty)
+    {
+        emit dirtyChanged(true);
+    }
+}
+
+
+void SettingsPanel::clearDirty()
+{
+    if(isDirty())
+    {
+        _dirty.clear();
+        emit dirtyChanged(false);
+    }
+}
+
+
+void SettingsPanel::finishBatch(const QStringList& changed, bool was_dirty)
 {
-    for(auto item: _items)
+    updateDependents(changed);
+    if(!was_dirty and isDirty())
     {
-        item->saveSetting();
+        emit dirtyChanged(true);
     }
 }
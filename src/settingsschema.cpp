@@ -0,0 +1,446 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+#include "settingsschema.h"
+
+namespace
+{
+    /**
+     * @brief Modification time and size of a file when it was read
+     */
+    struct FileVersion
+    {
+        QDateTime modified;
+        qint64 size;
+    };
+
+    /**
+     * @brief The files an expansion was built from by absolute path
+     */
+    typedef QHash<QString, FileVersion> FileVersions;
+
+    struct ParsedFile
+    {
+        FileVersion version;
+        QJsonArray content;
+        bool valid;
+    };
+
+    struct Fragment
+    {
+        QJsonArray items;
+        /**
+         * @brief Includes inside the fragment are relative to this directory
+         */
+        QString base_dir;
+        /**
+         * @brief Where the fragment is defined: a file, a fragment, an inline schema or code
+         */
+        QString source;
+    };
+
+    struct Expansion
+    {
+        QJsonArray items;
+        /**
+         * @brief All files the items were read from, nested includes included
+         */
+        FileVersions files;
+    };
+
+    QHash<QString, ParsedFile> _files;
+
+    QHash<QString, Fragment> _fragments;
+
+    /**
+     * @brief Expanded and parameterized fragments by fragment and parameters
+     */
+    QHash<QString, Expansion> _expanded;
+
+    FileVersion fileVersion(const QString& path)
+    {
+        QFileInfo info(path);
+        FileVersion version;
+        version.modified = info.lastModified();
+        version.size = info.size();
+        return version;
+    }
+
+    bool isCurrent(const QString& path, const FileVersion& version)
+    {
+        FileVersion current = fileVersion(path);
+        return current.modified == version.modified and current.size == version.size;
+    }
+
+    /**
+     * @brief Whether none of the files an expansion was built from changed since
+     */
+    bool isCurrent(const Expansion& expansion)
+    {
+        for (auto it = expansion.files.constBegin(); it != expansion.files.constEnd(); ++it)
+        {
+            if (!isCurrent(it.key(), it.value()))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const ParsedFile& parseFile(const QString& path)
+    {
+        auto it = _files.find(path);
+        if (it != _files.end() and isCurrent(path, it.value().version))
+        {
+            return it.value();
+        }
+
+        // expansions using the old content are detected by the versions they recorded
+        ParsedFile parsed;
+        parsed.version = fileVersion(path);
+        parsed.valid = false;
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            qWarning() << "Couldn't open json file " << path;
+        }
+        else
+        {
+            QJsonParseError error;
+            QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+            if (!document.isArray())
+            {
+                qWarning() << "Json file " << path << " does not contain a json array: " << error.errorString();
+            }
+            else
+            {
+                parsed.content = document.array();
+                parsed.valid = true;
+            }
+        }
+        return _files[path] = parsed;
+    }
+
+    QString substitute(QString text, const QJsonObject& params)
+    {
+        if (!text.contains("${"))
+        {
+            return text;
+        }
+        for (auto it = params.begin(); it != params.end(); ++it)
+        {
+            text.replace("${" + it.key() + "}", it.value().toVariant().toString());
+        }
+        return text;
+    }
+
+    QJsonValue substitute(const QJsonValue& value, const QJsonObject& params)
+    {
+        switch (value.type())
+        {
+            case QJsonValue::String:
+                return substitute(value.toString(), params);
+            case QJsonValue::Array:
+            {
+                QJsonArray result;
+                for (const QJsonValue& item: value.toArray())
+                {
+                    result.append(substitute(item, params));
+                }
+                return result;
+            }
+            case QJsonValue::Object:
+            {
+                QJsonObject obj = value.toObject();
+                QJsonObject result;
+                for (auto it = obj.begin(); it != obj.end(); ++it)
+                {
+                    result.insert(substitute(it.key(), params), substitute(it.value(), params));
+                }
+                return result;
+            }
+            default:
+                return value;
+        }
+    }
+
+    /**
+     * @brief Put a setting without section into the section, the children of groups included
+     */
+    void assignSection(QJsonObject& obj, const QString& section)
+    {
+        QString type = obj.value("type").toString();
+        if (type == "group")
+        {
+            QJsonArray children;
+            for (const QJsonValue& child: obj.value("children").toArray())
+            {
+                QJsonObject child_obj = child.toObject();
+                assignSection(child_obj, section);
+                children.append(child_obj);
+            }
+            obj.insert("children", children);
+        }
+        else if (!obj.contains("section") and type != "title" and type != "preset")
+        {
+            obj.insert("section", section);
+        }
+    }
+
+    QJsonArray parameterize(const QJsonArray& items, const QJsonObject& params)
+    {
+        if (params.isEmpty())
+        {
+            // shared with the cached fragment, no copy
+            return items;
+        }
+        QString section = params.value("section").toString();
+        QJsonArray result;
+        for (const QJsonValue& item: items)
+        {
+            QJsonObject obj = substitute(item, params).toObject();
+            if (!section.isEmpty())
+            {
+                assignSection(obj, section);
+            }
+            result.append(obj);
+        }
+        return result;
+    }
+
+    bool isDirective(const QJsonValue& value)
+    {
+        QJsonObject obj = value.toObject();
+        return obj.contains("$include") or obj.contains("$ref") or obj.contains("$fragment");
+    }
+
+    void defineFragment(const QString& name, const Fragment& fragment)
+    {
+        auto known = _fragments.find(name);
+        if (known == _fragments.end())
+        {
+            _fragments.insert(name, fragment);
+            return;
+        }
+        if (known.value().items == fragment.items and known.value().base_dir == fragment.base_dir)
+        {
+            known.value().source = fragment.source;
+            return;
+        }
+        // fragment names are global, a second definition replaces the first one for all schemas
+        if (known.value().source != fragment.source or fragment.source == "<inline schema>")
+        {
+            qWarning() << "Schema fragment " << name << " from " << fragment.source
+                       << " replaces the one from " << known.value().source;
+        }
+        known.value() = fragment;
+        // references to the fragment may be cached
+        _expanded.clear();
+    }
+
+    bool isGroup(const QJsonValue& value)
+    {
+        return value.toObject().value("children").isArray();
+    }
+
+    QJsonArray expandArray(const QJsonArray& schema, const QString& base_dir, QStringList& stack, FileVersions& files)
+    {
+        bool has_directives = false;
+        for (const QJsonValue& value: schema)
+        {
+            QJsonObject obj = value.toObject();
+            if (obj.contains("$fragment"))
+            {
+                // fragments may be referenced before their definition
+                Fragment fragment;
+                fragment.items = obj.value("items").toArray();
+                fragment.base_dir = base_dir;
+                fragment.source = stack.isEmpty() ? QString("<inline schema>") : stack.last();
+                defineFragment(obj.value("$fragment").toString(), fragment);
+            }
+            // groups may contain directives as well
+            has_directives = has_directives or isDirective(value) or isGroup(value);
+        }
+        if (!has_directives)
+        {
+            return schema;
+        }
+
+        QJsonArray result;
+        for (const QJsonValue& value: schema)
+        {
+            if (isGroup(value))
+            {
+                QJsonObject group = value.toObject();
+                group.insert("children", expandArray(group.value("children").toArray(), base_dir, stack, files));
+                result.append(group);
+                continue;
+            }
+            if (!isDirective(value))
+            {
+                result.append(value);
+                continue;
+            }
+            QJsonObject obj = value.toObject();
+            if (obj.contains("$fragment"))
+            {
+                continue;
+            }
+
+            QString key;
+            Fragment fragment;
+            if (obj.contains("$include"))
+            {
+                QString path = QDir(base_dir).absoluteFilePath(obj.value("$include").toString());
+                const ParsedFile& parsed = parseFile(path);
+                // a missing or broken file is a dependency as well, the schema changes once it is fixed
+                files.insert(path, parsed.version);
+                if (!parsed.valid)
+                {
+                    continue;
+                }
+                key = path;
+                fragment.items = parsed.content;
+                fragment.base_dir = QFileInfo(path).absolutePath();
+            }
+            else
+            {
+                QString name = obj.value("$ref").toString();
+                auto it = _fragments.constFind(name);
+                if (it == _fragments.constEnd())
+                {
+                    qWarning() << "Unknown schema fragment " << name << " - skipping it";
+                    continue;
+                }
+                key = "$ref:" + name;
+                fragment = it.value();
+            }
+            if (stack.contains(key))
+            {
+                qWarning() << "Cyclic schema include of " << key << " - skipping it";
+                continue;
+            }
+
+            obj.remove("$include");
+            obj.remove("$ref");
+            QString cache_key = key + "\n" + QString::fromUtf8(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+            auto cached = _expanded.constFind(cache_key);
+            if (cached == _expanded.constEnd() or !isCurrent(cached.value()))
+            {
+                Expansion expansion;
+                if (files.contains(key))
+                {
+                    // the included file itself
+                    expansion.files.insert(key, files.value(key));
+                }
+                stack << key;
+                QJsonArray expanded = expandArray(fragment.items, fragment.base_dir, stack, expansion.files);
+                stack.removeLast();
+                expansion.items = parameterize(expanded, obj);
+                cached = _expanded.insert(cache_key, expansion);
+            }
+            for (auto it = cached.value().files.constBegin(); it != cached.value().files.constEnd(); ++it)
+            {
+                files.insert(it.key(), it.value());
+            }
+            for (const QJsonValue& item: cached.value().items)
+            {
+                result.append(item);
+            }
+        }
+        return result;
+    }
+}
+
+
+namespace SettingsSchema
+{
+    QJsonArray load(const QString& filename, bool* ok)
+    {
+        QString path = QFileInfo(filename).absoluteFilePath();
+        const ParsedFile& parsed = parseFile(path);
+        if (ok)
+        {
+            *ok = parsed.valid;
+        }
+        if (!parsed.valid)
+        {
+            return QJsonArray();
+        }
+        // copied, parsing included files may move the cached entry
+        QJsonArray content = parsed.content;
+        QStringList stack;
+        stack << path;
+        FileVersions files;
+        return expandArray(content, QFileInfo(path).absolutePath(), stack, files);
+    }
+
+    QJsonArray expand(const QJsonArray& schema, const QString& base_dir)
+    {
+        QStringList stack;
+        FileVersions files;
+        return expandArray(schema, base_dir.isEmpty() ? QDir::currentPath() : base_dir, stack, files);
+    }
+
+    QStringList includedFiles(const QString& filename)
+    {
+        QString path = QFileInfo(filename).absoluteFilePath();
+        QJsonArray content = parseFile(path).content;
+        QStringList stack;
+        stack << path;
+        FileVersions files;
+        expandArray(content, QFileInfo(path).absolutePath(), stack, files);
+
+        QStringList included;
+        for (auto it = files.constBegin(); it != files.constEnd(); ++it)
+        {
+            if (it.key() != path and QFileInfo::exists(it.key()))
+            {
+                included << it.key();
+            }
+        }
+        included.sort();
+        return QStringList(path) + included;
+    }
+
+    void registerFragment(const QString& name, const QJsonArray& fragment)
+    {
+        Fragment entry;
+        entry.items = fragment;
+        entry.base_dir = QDir::currentPath();
+        entry.source = "<registerFragment>";
+        defineFragment(name, entry);
+    }
+
+    void clearCache()
+    {
+        _files.clear();
+        _expanded.clear();
+    }
+}
@@ -0,0 +1,501 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <QDataStream>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QTimer>
+#include "settingsserver.h"
+#include "settingsstore.h"
+
+namespace
+{
+    /**
+     * @brief Frame a payload with its length
+     */
+    QByteArray frame(const QByteArray& payload)
+    {
+        QByteArray data;
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_5_12);
+        stream << quint32(payload.size());
+        data.append(payload);
+        return data;
+    }
+
+    QByteArray message(quint8 type, quint32 id, const QByteArray& body = QByteArray())
+    {
+        QByteArray payload;
+        QDataStream stream(&payload, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_5_12);
+        stream << type << id;
+        payload.append(body);
+        return frame(payload);
+    }
+
+    /**
+     * @brief Split complete frames off the front of a buffer
+     *
+     * @return bool false if a frame exceeds the size limit
+     */
+    bool takeFrames(QByteArray& buffer, QList<QByteArray>& payloads)
+    {
+        while (buffer.size() >= int(sizeof(quint32)))
+        {
+            QDataStream stream(buffer);
+            stream.setVersion(QDataStream::Qt_5_12);
+            quint32 size;
+            stream >> size;
+            if (size > SettingsProtocol::max_frame_size)
+            {
+                return false;
+            }
+            if (quint32(buffer.size()) - sizeof(quint32) < size)
+            {
+                break;
+            }
+            payloads.append(buffer.mid(sizeof(quint32), size));
+            buffer.remove(0, sizeof(quint32) + size);
+        }
+        return true;
+    }
+
+    bool matchesAny(const QString& key, const QStringList& prefixes)
+    {
+        for (const QString& prefix: prefixes)
+        {
+            if (key.startsWith(prefix))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+
+SettingsServer::SettingsServer(SettingsWidget* widget, QSettings* settings, QObject* parent)
+    : QObject(parent), _widget(widget), _server(new QLocalServer(this))
+{
+    connect(_server, &QLocalServer::newConnection, this, &SettingsServer::acceptConnections);
+
+    SettingsStore* store = SettingsStore::forSettings(settings);
+    if (store)
+    {
+        connect(store, &SettingsStore::valueChanged, this, &SettingsServer::valueChanged);
+    }
+    else
+    {
+        qWarning() << "No SettingsStore for the settings of the server - subscribers won't be notified";
+    }
+}
+
+
+bool SettingsServer::listen(const QString& name)
+{
+    // the settings are only shared with processes of the same user
+    _server->setSocketOptions(QLocalServer::UserAccessOption);
+    if (_server->listen(name))
+    {
+        return true;
+    }
+    if (_server->serverError() == QAbstractSocket::AddressInUseError)
+    {
+        // only a socket file left behind by a crashed process is removed, never one of a running server
+        QLocalSocket probe;
+        probe.connectToServer(name);
+        if (probe.waitForConnected(1000))
+        {
+            probe.disconnectFromServer();
+            qWarning() << "Couldn't listen on " << name << ": another server is running";
+            return false;
+        }
+        QLocalServer::removeServer(name);
+        if (_server->listen(name))
+        {
+            return true;
+        }
+    }
+    qWarning() << "Couldn't listen on " << name << ": " << _server->errorString();
+    return false;
+}
+
+
+void SettingsServer::close()
+{
+    _server->close();
+    for (QLocalSocket* socket: _clients.keys())
+    {
+        socket->disconnectFromServer();
+    }
+}
+
+
+QString SettingsServer::serverName() const
+{
+    return _server->fullServerName();
+}
+
+
+void SettingsServer::acceptConnections()
+{
+    while (_server->hasPendingConnections())
+    {
+        QLocalSocket* socket = _server->nextPendingConnection();
+        _clients.insert(socket, Client());
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket](){readRequests(socket);});
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]()
+        {
+            _clients.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+
+void SettingsServer::readRequests(QLocalSocket* socket)
+{
+    auto it = _clients.find(socket);
+    if (it == _clients.end())
+    {
+        return;
+    }
+    it.value().buffer.append(socket->readAll());
+
+    QList<QByteArray> payloads;
+    if (!takeFrames(it.value().buffer, payloads))
+    {
+        qWarning() << "Oversized request from a settings client - closing the connection";
+        socket->abort();
+        return;
+    }
+    for (const QByteArray& payload: payloads)
+    {
+        handleRequest(socket, payload);
+    }
+}
+
+
+void SettingsServer::handleRequest(QLocalSocket* socket, const QByteArray& payload)
+{
+    QDataStream stream(payload);
+    stream.setVersion(QDataStream::Qt_5_12);
+    quint8 type;
+    quint32 id;
+    stream >> type >> id;
+
+    QByteArray body;
+    QDataStream reply(&body, QIODevice::WriteOnly);
+    reply.setVersion(QDataStream::Qt_5_12);
+    quint8 reply_type = SettingsProtocol::Error;
+
+    switch(type)
+    {
+        case SettingsProtocol::Get:
+        {
+            QStringList keys;
+            stream >> keys;
+            if (stream.status() != QDataStream::Ok)
+            {
+                break;
+            }
+            QVariantHash values;
+            for (const QString& key: keys)
+            {
+                QVariant value = _widget->savedValue(key);
+                if (value.isValid())
+                {
+                    values.insert(key, value);
+                }
+            }
+            reply << values;
+            reply_type = SettingsProtocol::GetReply;
+            break;
+        }
+        case SettingsProtocol::Set:
+        {
+            QVariantHash values;
+            bool save;
+            stream >> values >> save;
+            if (stream.status() != QDataStream::Ok)
+            {
+                break;
+            }
+            SettingsWidget::SnapshotReport report = _widget->applyValues(values);
+            if (save and report.applied > 0)
+            {
+                _widget->saveSettings();
+            }
+            reply << qint32(report.applied) << report.unknown << report.rejected;
+            reply_type = SettingsProtocol::SetReply;
+            break;
+        }
+        case SettingsProtocol::Subscribe:
+        case SettingsProtocol::Unsubscribe:
+        {
+            QStringList prefixes;
+            stream >> prefixes;
+            if (stream.status() != QDataStream::Ok)
+            {
+                break;
+            }
+            QStringList& subscriptions = _clients[socket].subscriptions;
+            for (const QString& prefix: prefixes)
+            {
+                if (type == SettingsProtocol::Unsubscribe)
+                {
+                    subscriptions.removeAll(prefix);
+                }
+                else if (!subscriptions.contains(prefix))
+                {
+                    subscriptions.append(prefix);
+                }
+            }
+            reply_type = SettingsProtocol::SubscribeReply;
+            break;
+        }
+        default:
+            reply << QString("Unknown request type %1").arg(int(type));
+            socket->write(message(reply_type, id, body));
+            return;
+    }
+
+    if (reply_type == SettingsProtocol::Error)
+    {
+        reply << QString("Malformed request");
+    }
+    socket->write(message(reply_type, id, body));
+}
+
+
+void SettingsServer::valueChanged(const QString& section, const QString& key)
+{
+    bool has_subscribers = false;
+    for (const Client& client: _clients)
+    {
+        has_subscribers = has_subscribers or !client.subscriptions.isEmpty();
+    }
+    if (!has_subscribers)
+    {
+        return;
+    }
+    if (_changed.isEmpty())
+    {
+        QTimer::singleShot(0, this, &SettingsServer::notifySubscribers);
+    }
+    _changed.insert(SettingsStore::path(section, key));
+}
+
+
+void SettingsServer::notifySubscribers()
+{
+    QVariantHash values;
+    for (const QString& key: _changed)
+    {
+        values.insert(key, _widget->savedValue(key));
+    }
+    _changed.clear();
+
+    for (auto it = _clients.constBegin(); it != _clients.constEnd(); ++it)
+    {
+        QVariantHash subscribed;
+        for (auto value_it = values.constBegin(); value_it != values.constEnd(); ++value_it)
+        {
+            if (matchesAny(value_it.key(), it.value().subscriptions))
+            {
+                subscribed.insert(value_it.key(), value_it.value());
+            }
+        }
+        if (subscribed.isEmpty())
+        {
+            continue;
+        }
+        QByteArray body;
+        QDataStream stream(&body, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_5_12);
+        stream << subscribed;
+        it.key()->write(message(SettingsProtocol::Notification, 0, body));
+    }
+}
+
+
+SettingsClient::SettingsClient(QObject* parent)
+    : QObject(parent), _socket(new QLocalSocket(this)), _next_id(1), _last_reply(0)
+{
+    connect(_socket, &QLocalSocket::readyRead, this, &SettingsClient::readReplies);
+}
+
+
+bool SettingsClient::connectToServer(const QString& name, int msecs)
+{
+    _buffer.clear();
+    _socket->connectToServer(name);
+    if (!_socket->waitForConnected(msecs))
+    {
+        qWarning() << "Couldn't connect to " << name << ": " << _socket->errorString();
+        return false;
+    }
+    return true;
+}
+
+
+bool SettingsClient::isConnected() const
+{
+    return _socket->state() == QLocalSocket::ConnectedState;
+}
+
+
+quint32 SettingsClient::get(const QStringList& keys)
+{
+    QByteArray body;
+    QDataStream stream(&body, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_12);
+    stream << keys;
+    return send(SettingsProtocol::Get, body);
+}
+
+
+quint32 SettingsClient::set(const QVariantHash& values, bool save)
+{
+    QByteArray body;
+    QDataStream stream(&body, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_12);
+    stream << values << save;
+    return send(SettingsProtocol::Set, body);
+}
+
+
+quint32 SettingsClient::subscribe(const QStringList& prefixes)
+{
+    QByteArray body;
+    QDataStream stream(&body, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_12);
+    stream << prefixes;
+    return send(SettingsProtocol::Subscribe, body);
+}
+
+
+quint32 SettingsClient::unsubscribe(const QStringList& prefixes)
+{
+    QByteArray body;
+    QDataStream stream(&body, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_12);
+    stream << prefixes;
+    return send(SettingsProtocol::Unsubscribe, body);
+}
+
+
+bool SettingsClient::waitForReply(quint32 id, int msecs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (_last_reply != id)
+    {
+        int remaining = msecs - int(timer.elapsed());
+        if (remaining <= 0 or !isConnected() or !_socket->waitForReadyRead(remaining))
+        {
+            return _last_reply == id;
+        }
+    }
+    return true;
+}
+
+
+quint32 SettingsClient::send(quint8 type, const QByteArray& body)
+{
+    quint32 id = _next_id++;
+    if (_next_id == 0)
+    {
+        // 0 is the id of notifications
+        _next_id = 1;
+    }
+    _socket->write(message(type, id, body));
+    return id;
+}
+
+
+void SettingsClient::readReplies()
+{
+    _buffer.append(_socket->readAll());
+    QList<QByteArray> payloads;
+    if (!takeFrames(_buffer, payloads))
+    {
+        qWarning() << "Oversized reply from the settings server - closing the connection";
+        _socket->abort();
+        return;
+    }
+    for (const QByteArray& payload: payloads)
+    {
+        handleReply(payload);
+    }
+}
+
+
+void SettingsClient::handleReply(const QByteArray& payload)
+{
+    QDataStream stream(payload);
+    stream.setVersion(QDataStream::Qt_5_12);
+    quint8 type;
+    quint32 id;
+    stream >> type >> id;
+
+    switch(type)
+    {
+        case SettingsProtocol::GetReply:
+        {
+            QVariantHash values;
+            stream >> values;
+            emit valuesReceived(id, values);
+            break;
+        }
+        case SettingsProtocol::SetReply:
+        {
+            qint32 applied;
+            QStringList unknown, rejected;
+            stream >> applied >> unknown >> rejected;
+            emit setFinished(id, applied, unknown, rejected);
+            break;
+        }
+        case SettingsProtocol::SubscribeReply:
+            emit subscribed(id);
+            break;
+        case SettingsProtocol::Notification:
+        {
+            QVariantHash values;
+            stream >> values;
+            emit valuesChanged(values);
+            break;
+        }
+        case SettingsProtocol::Error:
+        {
+            QString error;
+            stream >> error;
+            emit errorReceived(id, error);
+            break;
+        }
+        default:
+            qWarning() << "Unknown reply type " << type << " from the settings server - ignoring it";
+            return;
+    }
+    if (id != 0)
+    {
+        _last_reply = id;
+    }
+}
@@ -0,0 +1,507 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <vector>
+#include <QDataStream>
+#include <QDebug>
+#include <QThread>
+#include "settingssnapshot.h"
+
+namespace
+{
+    const quint32 _magic = 0x53575353;
+
+    const quint32 _format_version = 1;
+
+    const int _min_capacity = 64 * 1024;
+
+    /**
+     * @brief Readers give up after this many reads that overlapped with a write
+     */
+    const int _max_attempts = 1000;
+
+    struct Directory
+    {
+        quint32 magic;
+        quint32 version;
+        /**
+         * @brief Number of the current data segment, 0 before the first publication
+         */
+        std::atomic<quint32> segment;
+    };
+
+    struct Header
+    {
+        quint32 magic;
+        quint32 version;
+        /**
+         * @brief Twice the generation, odd while the snapshot is being written
+         */
+        std::atomic<quint32> sequence;
+        quint32 count;
+        quint32 size;
+    };
+
+    /**
+     * @brief Entry of the key table, offsets are relative to the start of the data
+     */
+    struct Record
+    {
+        quint32 key_offset;
+        quint32 key_length;
+        quint32 value_offset;
+        quint32 value_length;
+        quint32 type;
+    };
+
+    enum ValueType : quint32 {Invalid, Bool, Int, Double, String, Variant};
+
+    const int _data_offset = (sizeof(Header) + 7) & ~7;
+
+    quint32 append(QByteArray& data, const void* bytes, int length)
+    {
+        // keep every key and value 8 byte aligned
+        data.append(QByteArray((8 - data.size() % 8) % 8, '\0'));
+        quint32 offset = data.size();
+        data.append((const char*)bytes, length);
+        return offset;
+    }
+
+    QByteArray encode(const QVariantHash& values, quint32& count)
+    {
+        QStringList keys = values.keys();
+        std::sort(keys.begin(), keys.end());
+        count = keys.size();
+
+        std::vector<Record> records(count);
+        QByteArray data(int(count * sizeof(Record)), '\0');
+        for (quint32 i=0; i<count; ++i)
+        {
+            Record& record = records[i];
+            const QString& key = keys[i];
+            record.key_offset = append(data, key.constData(), key.size() * sizeof(QChar));
+            record.key_length = key.size();
+
+            const QVariant& value = values.value(key);
+            QByteArray bytes;
+            switch (value.type())
+            {
+                case QVariant::Invalid:
+                    record.type = Invalid;
+                    break;
+                case QVariant::Bool:
+                case QVariant::Int:
+                case QVariant::UInt:
+                case QVariant::LongLong:
+                {
+                    record.type = value.type() == QVariant::Bool ? Bool : Int;
+                    qint64 number = value.toLongLong();
+                    bytes = QByteArray((const char*)&number, sizeof(number));
+                    break;
+                }
+                case QVariant::Double:
+                {
+                    record.type = Double;
+                    double number = value.toDouble();
+                    bytes = QByteArray((const char*)&number, sizeof(number));
+                    break;
+                }
+                case QVariant::String:
+                {
+                    record.type = String;
+                    QString text = value.toString();
+                    bytes = QByteArray((const char*)text.constData(), text.size() * sizeof(QChar));
+                    break;
+                }
+                default:
+                {
+                    record.type = Variant;
+                    QDataStream stream(&bytes, QIODevice::WriteOnly);
+                    stream << value;
+                    break;
+                }
+            }
+            record.value_offset = append(data, bytes.constData(), bytes.size());
+            record.value_length = bytes.size();
+        }
+        std::memcpy(data.data(), records.data(), count * sizeof(Record));
+        return data;
+    }
+
+    /**
+     * @brief Read a record, all offsets are checked since a concurrent write may have scrambled them
+     */
+    bool readRecord(const char* data, quint32 size, quint32 idx, Record& record)
+    {
+        std::memcpy(&record, data + idx * sizeof(Record), sizeof(Record));
+        return record.key_offset <= size and record.key_length <= (size - record.key_offset) / sizeof(QChar)
+            and record.value_offset <= size and record.value_length <= size - record.value_offset;
+    }
+
+    QString recordKey(const char* data, const Record& record)
+    {
+        // no copy, only valid while the snapshot is read
+        return QString::fromRawData((const QChar*)(data + record.key_offset), record.key_length);
+    }
+
+    QVariant recordValue(const char* data, const Record& record)
+    {
+        const char* bytes = data + record.value_offset;
+        switch (record.type)
+        {
+            case Bool:
+            case Int:
+            case Double:
+            {
+                if (record.value_length != 8)
+                {
+                    return QVariant();
+                }
+                qint64 number;
+                std::memcpy(&number, bytes, sizeof(number));
+                if (record.type == Bool)
+                {
+                    return QVariant(number != 0);
+                }
+                if (record.type == Int)
+                {
+                    return QVariant(qlonglong(number));
+                }
+                double real;
+                std::memcpy(&real, bytes, sizeof(real));
+                return QVariant(real);
+            }
+            case String:
+                return QVariant(QString((const QChar*)bytes, record.value_length / sizeof(QChar)));
+            case Variant:
+            {
+                QByteArray raw = QByteArray::fromRawData(bytes, record.value_length);
+                QDataStream stream(raw);
+                QVariant value;
+                stream >> value;
+                return value;
+            }
+            default:
+                return QVariant();
+        }
+    }
+}
+
+
+SettingsSnapshotPublisher::SettingsSnapshotPublisher(const QString& name, SettingsStore* store, QObject* parent)
+    : QObject(parent), _name(name), _store(store), _directory(name), _segment(0), _generation(0)
+{
+    if (createDirectory())
+    {
+        publish();
+    }
+    connect(_store, &SettingsStore::synced, this, &SettingsSnapshotPublisher::publish);
+}
+
+
+bool SettingsSnapshotPublisher::publish()
+{
+    if (!_directory.isAttached())
+    {
+        return false;
+    }
+
+    quint32 count;
+    QByteArray data = encode(_store->values(), count);
+    bool moved = false;
+    if (!_data.isAttached() or _data.size() < _data_offset + data.size())
+    {
+        if (!createSegment(_data_offset + data.size()))
+        {
+            return false;
+        }
+        moved = true;
+    }
+
+    Header* header = (Header*)_data.data();
+    // only guards against other publishers, readers detect concurrent writes with the sequence
+    _data.lock();
+    quint32 sequence = header->sequence.load(std::memory_order_relaxed);
+    header->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy((char*)_data.data() + _data_offset, data.constData(), data.size());
+    header->count = count;
+    header->size = data.size();
+    header->sequence.store(sequence + 2, std::memory_order_release);
+    _data.unlock();
+    _generation = (sequence + 2) / 2;
+
+    if (moved)
+    {
+        Directory* directory = (Directory*)_directory.data();
+        directory->segment.store(_segment, std::memory_order_release);
+    }
+    return true;
+}
+
+
+quint32 SettingsSnapshotPublisher::generation() const
+{
+    return _generation;
+}
+
+
+bool SettingsSnapshotPublisher::createDirectory()
+{
+    if (_directory.create(sizeof(Directory)))
+    {
+        Directory* directory = (Directory*)_directory.data();
+        directory->magic = _magic;
+        directory->version = _format_version;
+        new (&directory->segment) std::atomic<quint32>(0);
+        return true;
+    }
+
+    if (_directory.error() != QSharedMemory::AlreadyExists or !_directory.attach())
+    {
+        qWarning() << "Could not create shared memory " << _name << ": " << _directory.errorString();
+        return false;
+    }
+    // left behind by an earlier publisher, continue after its last segment
+    const Directory* directory = (const Directory*)_directory.constData();
+    if (directory->magic != _magic or directory->version != _format_version)
+    {
+        qWarning() << "Shared memory " << _name << " is not a settings snapshot";
+        _directory.detach();
+        return false;
+    }
+    _segment = directory->segment.load(std::memory_order_acquire);
+    if (_segment == 0)
+    {
+        return true;
+    }
+
+    // readers compare generations, so they have to continue from the last published one
+    QSharedMemory current(_name + "." + QString::number(_segment));
+    if (current.attach(QSharedMemory::ReadOnly))
+    {
+        const Header* header = (const Header*)current.constData();
+        if (header->magic == _magic and header->version == _format_version)
+        {
+            // an odd sequence was left by a publisher that died while writing
+            _generation = (header->sequence.load(std::memory_order_acquire) + 1) / 2;
+        }
+        current.detach();
+    }
+    return true;
+}
+
+
+bool SettingsSnapshotPublisher::createSegment(int size)
+{
+    // readers that are still attached keep the old segment alive until they follow the directory
+    _data.detach();
+
+    int capacity = qMax(_min_capacity, 2 * size);
+    for (int attempt=0; attempt<16; ++attempt)
+    {
+        ++_segment;
+        _data.setKey(_name + "." + QString::number(_segment));
+        if (_data.create(capacity))
+        {
+            Header* header = (Header*)_data.data();
+            header->magic = _magic;
+            header->version = _format_version;
+            new (&header->sequence) std::atomic<quint32>(2 * _generation);
+            header->count = 0;
+            header->size = 0;
+            return true;
+        }
+        if (_data.error() != QSharedMemory::AlreadyExists)
+        {
+            break;
+        }
+    }
+    qWarning() << "Could not create shared memory for " << _name << ": " << _data.errorString();
+    return false;
+}
+
+
+SettingsSnapshotReader::SettingsSnapshotReader(const QString& name)
+    : _name(name), _directory(name), _segment(0)
+{
+}
+
+
+bool SettingsSnapshotReader::attach()
+{
+    if (!_directory.isAttached() and !_directory.attach(QSharedMemory::ReadOnly))
+    {
+        return false;
+    }
+    const Directory* directory = (const Directory*)_directory.constData();
+    if (directory->magic != _magic or directory->version != _format_version)
+    {
+        qWarning() << "Shared memory " << _name << " is not a settings snapshot";
+        _directory.detach();
+        return false;
+    }
+    return ensureCurrent();
+}
+
+
+bool SettingsSnapshotReader::isAttached() const
+{
+    return _data.isAttached();
+}
+
+
+quint32 SettingsSnapshotReader::generation()
+{
+    if (!ensureCurrent())
+    {
+        return 0;
+    }
+    const Header* header = (const Header*)_data.constData();
+    return header->sequence.load(std::memory_order_acquire) / 2;
+}
+
+
+template<typename Read>
+bool SettingsSnapshotReader::readConsistent(Read read)
+{
+    if (!ensureCurrent())
+    {
+        return false;
+    }
+    const Header* header = (const Header*)_data.constData();
+    const char* data = (const char*)_data.constData() + _data_offset;
+    quint32 capacity = _data.size() - _data_offset;
+    for (int attempt=0; attempt<_max_attempts; ++attempt)
+    {
+        quint32 sequence = header->sequence.load(std::memory_order_acquire);
+        if (sequence % 2)
+        {
+            QThread::yieldCurrentThread();
+            continue;
+        }
+        quint32 size = qMin(header->size, capacity);
+        quint32 count = qMin(header->count, quint32(size / sizeof(Record)));
+        read(data, size, count);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header->sequence.load(std::memory_order_relaxed) == sequence)
+        {
+            return true;
+        }
+    }
+    qWarning() << "Could not read a consistent snapshot of " << _name;
+    return false;
+}
+
+QVariant SettingsSnapshotReader::value(const QString& section, const QString& key)
+{
+    QString full_key = SettingsStore::path(section, key);
+    QVariant value;
+    readConsistent([&](const char* data, quint32 size, quint32 count) {
+        value = QVariant();
+        // binary search in the sorted key table
+        quint32 first = 0;
+        quint32 last = count;
+        while (first < last)
+        {
+            quint32 middle = first + (last - first) / 2;
+            Record record;
+            if (!readRecord(data, size, middle, record))
+            {
+                return;
+            }
+            int order = recordKey(data, record).compare(full_key);
+            if (order == 0)
+            {
+                value = recordValue(data, record);
+                return;
+            }
+            if (order < 0)
+            {
+                first = middle + 1;
+            }
+            else
+            {
+                last = middle;
+            }
+        }
+    });
+    return value;
+}
+
+
+QVariantHash SettingsSnapshotReader::values()
+{
+    QVariantHash values;
+    readConsistent([&](const char* data, quint32 size, quint32 count) {
+        values.clear();
+        for (quint32 i=0; i<count; ++i)
+        {
+            Record record;
+            if (readRecord(data, size, i, record))
+            {
+                // the key has to be copied, the shared memory may change after the read
+                values.insert(QString(recordKey(data, record).constData(), record.key_length),
+                              recordValue(data, record));
+            }
+        }
+    });
+    return values;
+}
+
+
+bool SettingsSnapshotReader::ensureCurrent()
+{
+    if (!_directory.isAttached())
+    {
+        return false;
+    }
+    const Directory* directory = (const Directory*)_directory.constData();
+    quint32 segment = directory->segment.load(std::memory_order_acquire);
+    if (segment == _segment and _data.isAttached())
+    {
+        return true;
+    }
+    if (segment == 0)
+    {
+        // nothing published yet
+        return false;
+    }
+
+    _data.detach();
+    _data.setKey(_name + "." + QString::number(segment));
+    if (!_data.attach(QSharedMemory::ReadOnly))
+    {
+        return false;
+    }
+    const Header* header = (const Header*)_data.constData();
+    if (_data.size() < _data_offset or header->magic != _magic or header->version != _format_version)
+    {
+        _data.detach();
+        return false;
+    }
+    _segment = segment;
+    return true;
+}
+
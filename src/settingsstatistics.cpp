@@ -0,0 +1,227 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QSet>
+#include <QTextStream>
+#include "settingsstatistics.h"
+#include "settingsstore.h"
+
+namespace
+{
+    typedef QHash<QString, SettingsStatistics::Counter> Counters;
+
+    std::atomic<bool> _enabled(false);
+
+    void merge(const Counters& from, Counters& to)
+    {
+        for (auto it = from.constBegin(); it != from.constEnd(); ++it)
+        {
+            SettingsStatistics::Counter& counter = to[it.key()];
+            counter.reads += it.value().reads;
+            counter.writes += it.value().writes;
+            counter.nsecs += it.value().nsecs;
+        }
+    }
+
+    /**
+     * @brief The counters of one thread
+     *
+     * The mutex is only contended while the statistics are collected, so locking it is cheap
+     * for the counting thread.
+     */
+    struct ThreadCounters
+    {
+        QMutex mutex;
+        Counters counters;
+
+        ThreadCounters();
+        ~ThreadCounters();
+    };
+
+    QMutex& registryMutex()
+    {
+        static QMutex mutex;
+        return mutex;
+    }
+
+    QSet<ThreadCounters*>& registry()
+    {
+        static QSet<ThreadCounters*> threads;
+        return threads;
+    }
+
+    /**
+     * @brief The counters of threads that finished
+     */
+    Counters& retired()
+    {
+        static Counters counters;
+        return counters;
+    }
+
+    ThreadCounters::ThreadCounters()
+    {
+        QMutexLocker locker(&registryMutex());
+        registry().insert(this);
+    }
+
+    ThreadCounters::~ThreadCounters()
+    {
+        QMutexLocker locker(&registryMutex());
+        registry().remove(this);
+        merge(counters, retired());
+    }
+
+    ThreadCounters& threadCounters()
+    {
+        thread_local ThreadCounters counters;
+        return counters;
+    }
+}
+
+
+namespace SettingsStatistics
+{
+    Timer::Timer(Operation operation, const QString& section, const QString& key)
+        : _operation(operation)
+    {
+        if (_enabled.load(std::memory_order_relaxed))
+        {
+            _path = SettingsStore::path(section, key);
+            _timer.start();
+        }
+    }
+
+    Timer::Timer(Operation operation, const QString& path)
+        : _operation(operation)
+    {
+        if (_enabled.load(std::memory_order_relaxed))
+        {
+            _path = path;
+            _timer.start();
+        }
+    }
+
+    Timer::~Timer()
+    {
+        if (!_path.isEmpty())
+        {
+            record(_operation, _path, _timer.nsecsElapsed());
+        }
+    }
+
+    void setEnabled(bool enabled)
+    {
+        _enabled = enabled;
+    }
+
+    bool isEnabled()
+    {
+        return _enabled;
+    }
+
+    void record(Operation operation, const QString& path, qint64 nsecs)
+    {
+        ThreadCounters& thread = threadCounters();
+        QMutexLocker locker(&thread.mutex);
+        Counter& counter = thread.counters[path];
+        if (operation == Read)
+        {
+            ++counter.reads;
+        }
+        else
+        {
+            ++counter.writes;
+        }
+        counter.nsecs += nsecs;
+    }
+
+    QHash<QString, Counter> collect()
+    {
+        QMutexLocker locker(&registryMutex());
+        Counters counters = retired();
+        for (ThreadCounters* thread: registry())
+        {
+            QMutexLocker thread_locker(&thread->mutex);
+            merge(thread->counters, counters);
+        }
+        return counters;
+    }
+
+    void reset()
+    {
+        QMutexLocker locker(&registryMutex());
+        retired().clear();
+        for (ThreadCounters* thread: registry())
+        {
+            QMutexLocker thread_locker(&thread->mutex);
+            thread->counters.clear();
+        }
+    }
+
+    QByteArray toJson()
+    {
+        Counters counters = collect();
+        QJsonObject json;
+        for (auto it = counters.constBegin(); it != counters.constEnd(); ++it)
+        {
+            json.insert(it.key(), QJsonObject{{"reads", double(it.value().reads)},
+                                              {"writes", double(it.value().writes)},
+                                              {"msec", it.value().nsecs / 1e6}});
+        }
+        return QJsonDocument(json).toJson();
+    }
+
+    QString toTable()
+    {
+        Counters counters = collect();
+        std::vector<QString> paths;
+        int width = 3;
+        for (auto it = counters.constBegin(); it != counters.constEnd(); ++it)
+        {
+            paths.push_back(it.key());
+            width = qMax(width, it.key().size());
+        }
+        std::sort(paths.begin(), paths.end(), [&counters](const QString& a, const QString& b) {
+            const Counter& first = counters[a];
+            const Counter& second = counters[b];
+            return first.reads + first.writes > second.reads + second.writes;
+        });
+
+        QString table;
+        QTextStream out(&table);
+        out << QString("key").leftJustified(width) << "      reads     writes       msec\n";
+        for (const QString& path: paths)
+        {
+            const Counter& counter = counters[path];
+            out << path.leftJustified(width) << QString::number(counter.reads).rightJustified(11)
+                << QString::number(counter.writes).rightJustified(11)
+                << QString::number(counter.nsecs / 1e6, 'f', 3).rightJustified(11) << "\n";
+        }
+        out.flush();
+        return table;
+    }
+}
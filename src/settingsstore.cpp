@@ -0,0 +1,634 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSet>
+#include "settingsstore.h"
+#include "settingsstatistics.h"
+
+namespace
+{
+    QHash<QSettings*, SettingsStore*> _stores;
+
+    /**
+     * @brief Base name of the shard file of a top level section, "%" for keys without section
+     */
+    QString shardFileName(const QString& name)
+    {
+        // percent encoding gives a valid file name for any section and never a lone "%"
+        return name.isEmpty() ? QString("%") : QString::fromLatin1(name.toUtf8().toPercentEncoding());
+    }
+
+    QString shardName(const QString& filename)
+    {
+        QString base_name = QFileInfo(filename).completeBaseName();
+        return base_name == "%" ? QString() : QString::fromUtf8(QByteArray::fromPercentEncoding(base_name.toLatin1()));
+    }
+
+    QString shardOf(const QString& path)
+    {
+        int idx = path.indexOf('/');
+        return idx < 0 ? QString() : path.left(idx);
+    }
+}
+
+
+SettingsStore::SettingsStore(QSettings* user, QSettings* system, QObject* parent)
+    : QObject(parent), _user(user), _user_paths_loaded(false), _system(system)
+{
+    if (_stores.contains(_user))
+    {
+        qWarning() << "QSettings instance already has a SettingsStore - replacing it";
+    }
+    _stores[_user] = this;
+}
+
+
+SettingsStore::~SettingsStore()
+{
+    if (_stores.value(_user) == this)
+    {
+        _stores.remove(_user);
+    }
+}
+
+
+SettingsStore* SettingsStore::forSettings(QSettings* settings)
+{
+    return _stores.value(settings, nullptr);
+}
+
+
+QVariant SettingsStore::readValue(QSettings* settings, const QString& section, const QString& key,
+                                  const QVariant& default_value)
+{
+    SettingsStatistics::Timer timer(SettingsStatistics::Read, section, key);
+    SettingsStore* store = forSettings(settings);
+    if (!store)
+    {
+        return settings->value(path(section, key), default_value);
+    }
+
+    QString full_key = path(section, key);
+    if (default_value.isValid() and !store->_defaults.contains(full_key))
+    {
+        // the item's default is the schema default unless it was set explicitly
+        store->setDefault(section, key, default_value);
+    }
+    const Resolved& resolved = store->resolve(full_key);
+    return resolved.value.isValid() ? resolved.value : default_value;
+}
+
+
+QVariant SettingsStore::readUserValue(QSettings* settings, const QString& section, const QString& key)
+{
+    SettingsStore* store = forSettings(settings);
+    if (!store)
+    {
+        return settings->value(path(section, key));
+    }
+    return store->userValue(section, key);
+}
+
+
+bool SettingsStore::containsUserValues(QSettings* settings, const QString& section, const QString& key)
+{
+    SettingsStore* store = forSettings(settings);
+    QString full_key = path(section, key);
+    QString user_key = full_key;
+    QSettings* user = store ? store->userSettingsFor(full_key, user_key) : settings;
+    if (user->contains(user_key))
+    {
+        return true;
+    }
+    user->beginGroup(user_key);
+    bool found = !user->allKeys().isEmpty();
+    user->endGroup();
+    return found;
+}
+
+
+void SettingsStore::writeValue(QSettings* settings, const QString& section, const QString& key, const QVariant& value)
+{
+    SettingsStatistics::Timer timer(SettingsStatistics::Write, section, key);
+    SettingsStore* store = forSettings(settings);
+    if (!store)
+    {
+        settings->setValue(path(section, key), value);
+        return;
+    }
+    store->setValue(section, key, value);
+}
+
+
+void SettingsStore::writeValues(QSettings* settings, const QVariantHash& values)
+{
+    SettingsStore* store = forSettings(settings);
+    for (auto it = values.constBegin(); it != values.constEnd(); ++it)
+    {
+        SettingsStatistics::Timer timer(SettingsStatistics::Write, it.key());
+        if (store)
+        {
+            QString section, key;
+            splitPath(it.key(), section, key);
+            store->setValue(section, key, it.value());
+        }
+        else
+        {
+            settings->setValue(it.key(), it.value());
+        }
+    }
+}
+
+
+void SettingsStore::removeValue(QSettings* settings, const QString& section, const QString& key)
+{
+    SettingsStatistics::Timer timer(SettingsStatistics::Write, section, key);
+    SettingsStore* store = forSettings(settings);
+    if (!store)
+    {
+        settings->remove(path(section, key));
+        return;
+    }
+    store->remove(section, key);
+}
+
+
+void SettingsStore::syncSettings(QSettings* settings)
+{
+    SettingsStore* store = forSettings(settings);
+    if (!store)
+    {
+        settings->sync();
+        return;
+    }
+    store->sync();
+}
+
+
+QString SettingsStore::path(const QString& section, const QString& key)
+{
+    if (section.isEmpty())
+    {
+        return key;
+    }
+    return section + "/" + key;
+}
+
+
+void SettingsStore::splitPath(const QString& path, QString& section, QString& key)
+{
+    int idx = path.lastIndexOf('/');
+    section = idx < 0 ? QString() : path.left(idx);
+    key = path.mid(idx + 1);
+}
+
+
+QString SettingsStore::layerName(Layer layer)
+{
+    switch(layer)
+    {
+        case DefaultLayer:
+            return "default";
+        case SystemLayer:
+            return "system";
+        case UserLayer:
+            return "user";
+        case SessionLayer:
+            return "session";
+    }
+    return QString();
+}
+
+
+QSettings* SettingsStore::userSettings() const
+{
+    return _user;
+}
+
+
+QSettings* SettingsStore::systemSettings() const
+{
+    return _system;
+}
+
+
+void SettingsStore::setSystemSettings(QSettings* system)
+{
+    _system = system;
+    reloadLayer(SystemLayer);
+}
+
+
+void SettingsStore::setShardDirectory(const QString& directory)
+{
+    for (QSettings* settings: _shards)
+    {
+        settings->sync();
+        delete settings;
+    }
+    _shards.clear();
+    _dirty_shards.clear();
+    _user_paths.clear();
+    _user_paths_loaded = false;
+    bool first_switch = _shard_directory.isEmpty() and !directory.isEmpty();
+    _shard_directory = directory;
+    if (!directory.isEmpty() and !QDir().mkpath(directory))
+    {
+        qWarning() << "Couldn't create shard directory " << directory;
+    }
+    if (first_switch)
+    {
+        moveUserValuesToShards();
+    }
+    reloadLayer(UserLayer);
+}
+
+
+QStringList SettingsStore::loadedShards() const
+{
+    return _shards.keys();
+}
+
+
+void SettingsStore::setDefault(const QString& section, const QString& key, const QVariant& value)
+{
+    _defaults[path(section, key)] = value;
+    refresh(section, key);
+}
+
+
+void SettingsStore::setSessionValue(const QString& section, const QString& key, const QVariant& value)
+{
+    _session[path(section, key)] = value;
+    refresh(section, key);
+}
+
+
+void SettingsStore::clearSessionValue(const QString& section, const QString& key)
+{
+    if (_session.remove(path(section, key)))
+    {
+        refresh(section, key);
+    }
+}
+
+
+int SettingsStore::parseArguments(const QStringList& arguments)
+{
+    int count = 0;
+    for (int i=0; i<arguments.size(); ++i)
+    {
+        QString assignment;
+        if (arguments[i] == "--set" and i+1 < arguments.size())
+        {
+            assignment = arguments[++i];
+        }
+        else if (arguments[i].startsWith("--set="))
+        {
+            assignment = arguments[i].mid(6);
+        }
+        else
+        {
+            continue;
+        }
+
+        int idx = assignment.indexOf('=');
+        if (idx <= 0)
+        {
+            qWarning() << "Invalid session override " << assignment << " - expected section/key=value";
+            continue;
+        }
+        QString section, key;
+        splitPath(assignment.left(idx), section, key);
+        setSessionValue(section, key, assignment.mid(idx + 1));
+        ++count;
+    }
+    return count;
+}
+
+
+QVariant SettingsStore::value(const QString& section, const QString& key) const
+{
+    return resolve(path(section, key)).value;
+}
+
+
+QVariant SettingsStore::userValue(const QString& section, const QString& key) const
+{
+    QString user_key;
+    return userSettingsFor(path(section, key), user_key)->value(user_key);
+}
+
+
+SettingsStore::Layer SettingsStore::layer(const QString& section, const QString& key) const
+{
+    return resolve(path(section, key)).layer;
+}
+
+
+void SettingsStore::setValue(const QString& section, const QString& key, const QVariant& value)
+{
+    QString full_key = path(section, key);
+    QString user_key;
+    QSettings* user = userSettingsFor(full_key, user_key);
+    if (not _session.contains(full_key) and user->contains(user_key) and user->value(user_key) == value)
+    {
+        return;
+    }
+    user->setValue(user_key, value);
+    markShardDirty(full_key);
+    if (_user_paths_loaded)
+    {
+        _user_paths.insert(full_key);
+    }
+    _session.remove(full_key);
+    refresh(section, key);
+}
+
+
+void SettingsStore::remove(const QString& section, const QString& key)
+{
+    QString full_key = path(section, key);
+    QString user_key;
+    userSettingsFor(full_key, user_key)->remove(user_key);
+    markShardDirty(full_key);
+    if (_user_paths_loaded)
+    {
+        // QSettings::remove also removes the keys below
+        QString prefix = full_key + "/";
+        auto it = _user_paths.begin();
+        while (it != _user_paths.end())
+        {
+            if (*it == full_key or it->startsWith(prefix))
+            {
+                it = _user_paths.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+    _session.remove(full_key);
+    refresh(section, key);
+}
+
+
+void SettingsStore::invalidate(const QString& section, const QString& key)
+{
+    refresh(section, key);
+}
+
+
+void SettingsStore::reloadLayer(Layer layer)
+{
+    if (layer == UserLayer)
+    {
+        _user->sync();
+        for (QSettings* settings: _shards)
+        {
+            settings->sync();
+        }
+        _dirty_shards.clear();
+        // the files might have been changed by another process
+        _user_paths.clear();
+        _user_paths_loaded = false;
+    }
+    else if (layer == SystemLayer and _system)
+    {
+        _system->sync();
+    }
+
+    // only keys that have been read so far need to be recomputed
+    QStringList paths = _resolved.keys();
+    for (const QString& full_key: paths)
+    {
+        QString section, key;
+        splitPath(full_key, section, key);
+        refresh(section, key);
+    }
+}
+
+
+QVariantHash SettingsStore::values() const
+{
+    QSet<QString> paths = userPaths();
+    if (_system)
+    {
+        for (const QString& key: _system->allKeys())
+        {
+            paths.insert(key);
+        }
+    }
+    for (auto it = _defaults.constBegin(); it != _defaults.constEnd(); ++it)
+    {
+        paths.insert(it.key());
+    }
+    for (auto it = _session.constBegin(); it != _session.constEnd(); ++it)
+    {
+        paths.insert(it.key());
+    }
+
+    QVariantHash values;
+    for (const QString& full_key: paths)
+    {
+        const Resolved& resolved = resolve(full_key);
+        if (resolved.value.isValid())
+        {
+            values.insert(full_key, resolved.value);
+        }
+    }
+    return values;
+}
+
+
+void SettingsStore::sync()
+{
+    _user->sync();
+    // QSettings writes through a temporary file that is renamed, one write per changed shard
+    for (const QString& name: _dirty_shards)
+    {
+        _shards.value(name)->sync();
+    }
+    _dirty_shards.clear();
+    emit synced();
+}
+
+
+const SettingsStore::Resolved& SettingsStore::resolve(const QString& path) const
+{
+    auto it = _resolved.find(path);
+    if (it == _resolved.end())
+    {
+        it = _resolved.insert(path, lookup(path));
+    }
+    return it.value();
+}
+
+
+SettingsStore::Resolved SettingsStore::lookup(const QString& path) const
+{
+    Resolved resolved;
+    auto session_it = _session.find(path);
+    if (session_it != _session.end())
+    {
+        resolved.value = session_it.value();
+        resolved.layer = SessionLayer;
+        return resolved;
+    }
+
+    QString user_key;
+    resolved.value = userSettingsFor(path, user_key)->value(user_key);
+    if (resolved.value.isValid())
+    {
+        resolved.layer = UserLayer;
+        return resolved;
+    }
+
+    if (_system)
+    {
+        resolved.value = _system->value(path);
+        if (resolved.value.isValid())
+        {
+            resolved.layer = SystemLayer;
+            return resolved;
+        }
+    }
+
+    resolved.value = _defaults.value(path);
+    resolved.layer = DefaultLayer;
+    return resolved;
+}
+
+
+void SettingsStore::refresh(const QString& section, const QString& key)
+{
+    QString full_key = path(section, key);
+    auto it = _resolved.find(full_key);
+    if (it == _resolved.end())
+    {
+        // not cached yet, will be resolved on first access
+        return;
+    }
+
+    Resolved resolved = lookup(full_key);
+    if (resolved.layer == it.value().layer and resolved.value == it.value().value)
+    {
+        return;
+    }
+    it.value() = resolved;
+    emit valueChanged(section, key);
+}
+
+
+QSettings* SettingsStore::userSettingsFor(const QString& path, QString& user_key) const
+{
+    if (_shard_directory.isEmpty())
+    {
+        user_key = path;
+        return _user;
+    }
+    user_key = path.mid(path.indexOf('/') + 1);
+    return shard(shardOf(path));
+}
+
+
+QSettings* SettingsStore::shard(const QString& name) const
+{
+    auto it = _shards.constFind(name);
+    if (it != _shards.constEnd())
+    {
+        return it.value();
+    }
+    QString filename = shardFileName(name) + ".ini";
+    QSettings* settings = new QSettings(QDir(_shard_directory).filePath(filename), QSettings::IniFormat,
+                                        const_cast<SettingsStore*>(this));
+    _shards.insert(name, settings);
+    return settings;
+}
+
+
+void SettingsStore::markShardDirty(const QString& path)
+{
+    if (!_shard_directory.isEmpty())
+    {
+        _dirty_shards.insert(shardOf(path));
+    }
+}
+
+
+void SettingsStore::moveUserValuesToShards()
+{
+    QStringList keys = _user->allKeys();
+    if (keys.isEmpty())
+    {
+        return;
+    }
+    for (const QString& key: keys)
+    {
+        QString user_key;
+        QSettings* settings = userSettingsFor(key, user_key);
+        // a shard that already contains the key was written after the user file
+        if (!settings->contains(user_key))
+        {
+            settings->setValue(user_key, _user->value(key));
+            markShardDirty(key);
+        }
+    }
+    for (const QString& name: _dirty_shards)
+    {
+        _shards.value(name)->sync();
+    }
+    _dirty_shards.clear();
+    _user->clear();
+    _user->sync();
+}
+
+
+QSet<QString> SettingsStore::userPaths() const
+{
+    if (_shard_directory.isEmpty())
+    {
+        QSet<QString> paths;
+        for (const QString& key: _user->allKeys())
+        {
+            paths.insert(key);
+        }
+        return paths;
+    }
+    if (!_user_paths_loaded)
+    {
+        // all shards are needed once, including the ones nobody accessed so far, later writes update the index
+        QDir directory(_shard_directory);
+        for (const QString& filename: directory.entryList(QStringList() << "*.ini", QDir::Files))
+        {
+            QString name = shardName(filename);
+            for (const QString& key: shard(name)->allKeys())
+            {
+                _user_paths.insert(name.isEmpty() ? key : name + "/" + key);
+            }
+        }
+        _user_paths_loaded = true;
+    }
+    return _user_paths;
+}
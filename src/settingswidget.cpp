@@ -19,7 +19,11 @@
  */
 
 #include <iostream>
+#include <QCborMap>
+#include <QCborValue>
+#include <QFileInfo>
 #include "settingswidget.h"
+#include "settingshelp.h"
 
 
 SettingsWidget::SettingsWidget(QSettings* settings, QWidget* parent, QTabWidget::TabPosition position)
@@ -38,6 +42,7 @@ SettingsWidget::SettingsWidget(QSettings* settings, QWidget* parent, QTabWidget:
     setLayout(layout);
 
     connect(_buttons, &QDialogButtonBox::clicked, this, &SettingsWidget::on_buttonClicked);
+    connect(_panel_container, &QTabWidget::currentChanged, this, &SettingsWidget::panelShown);
 }
 
 
@@ -48,38 +53,342 @@ void SettingsWidget::setTabbarPosition(QTabWidget::TabPosition position)
 }
 
 
+void SettingsWidget::setProgressiveConstruction(bool progressive)
+{
+    _progressive = progressive;
+}
+
+
+void SettingsWidget::setLiteItems(bool lite)
+{
+    _lite = lite;
+}
+
+
+void SettingsWidget::setSchemaWatching(bool watch)
+{
+    if(!watch)
+    {
+        delete _schema_watcher;
+        _schema_watcher = nullptr;
+        _schema_reload_timer = nullptr;
+        _changed_schema_files.clear();
+        return;
+    }
+    if(_schema_watcher)
+    {
+        return;
+    }
+
+    _schema_watcher = new QFileSystemWatcher(this);
+    _schema_reload_timer = new QTimer(_schema_watcher);
+    _schema_reload_timer->setSingleShot(true);
+    _schema_reload_timer->setInterval(200);
+    connect(_schema_reload_timer, &QTimer::timeout, this, &SettingsWidget::reloadSchemas);
+    connect(_schema_watcher, &QFileSystemWatcher::fileChanged, this, [this](const QString& path) {
+        _changed_schema_files.insert(path);
+        _schema_reload_timer->start();
+    });
+    watchSchemaFiles();
+}
+
+
+void SettingsWidget::setEvictionBudget(qint64 budget, BudgetUnit unit)
+{
+    _eviction_budget = budget;
+    _budget_unit = unit;
+    applyEvictionBudget();
+}
+
+
+void SettingsWidget::setCache(SettingsCache* cache)
+{
+    _cache = cache;
+    publishCache();
+}
+
+
+QStringList SettingsWidget::presetNames() const
+{
+    QSet<QString> names;
+    for(int i=0; i<_panel_container->count(); ++i)
+    {
+        SettingsPanel* panel = (SettingsPanel*)_panel_container->widget(i);
+        for(const QString& name: panel->presets().keys())
+        {
+            names.insert(name);
+        }
+    }
+    for(const QString& name: presetSettings()->childKeys())
+    {
+        names.insert(name);
+    }
+
+    QStringList sorted = names.values();
+    sorted.sort();
+    return sorted;
+}
+
+
+bool SettingsWidget::applyPreset(const QString& name)
+{
+    QVariantHash values;
+    bool found = false;
+    for(int i=0; i<_panel_container->count(); ++i)
+    {
+        SettingsPanel* panel = (SettingsPanel*)_panel_container->widget(i);
+        QHash<QString, QVariantHash> presets = panel->presets();
+        auto preset = presets.constFind(name);
+        if(preset == presets.constEnd())
+        {
+            continue;
+        }
+        found = true;
+        for(auto it = preset.value().constBegin(); it != preset.value().constEnd(); ++it)
+        {
+            values.insert(it.key(), it.value());
+        }
+    }
+    QVariant user_preset = presetSettings()->value(name);
+    if(user_preset.isValid())
+    {
+        found = true;
+        QVariantMap user_values = user_preset.toMap();
+        for(auto it = user_values.constBegin(); it != user_values.constEnd(); ++it)
+        {
+            values.insert(it.key(), it.value());
+        }
+    }
+    if(!found)
+    {
+        qWarning() << "There is no preset " << name;
+        return false;
+    }
+
+    for(int i=0; i<_panel_container->count(); ++i)
+    {
+        SettingsPanel* panel = (SettingsPanel*)_panel_container->widget(i);
+        panel->applyValues(values);
+    }
+    return true;
+}
+
+
+void SettingsWidget::savePreset(const QString& name)
+{
+    QVariantHash values;
+    for(int i=0; i<_panel_container->count(); ++i)
+    {
+        SettingsPanel* panel = (SettingsPanel*)_panel_container->widget(i);
+        panel->collectCurrentValues(values);
+    }
+    QVariantMap preset;
+    for(auto it = values.constBegin(); it != values.constEnd(); ++it)
+    {
+        preset.insert(it.key(), it.value());
+    }
+    presetSettings()->setValue(name, preset);
+}
+
+
+void SettingsWidget::removePreset(const QString& name)
+{
+    presetSettings()->remove(name);
+}
+
+
+QSettings* SettingsWidget::presetSettings() const
+{
+    if(!_preset_settings)
+    {
+        // keeping the presets out of the settings keeps them out of the values, the store and exports
+        QString filename = _settings->fileName();
+        QString suffix = QFileInfo(filename).suffix();
+        if(suffix.isEmpty())
+        {
+            filename += "_presets";
+        }
+        else
+        {
+            filename.insert(filename.size() - suffix.size() - 1, "_presets");
+        }
+        _preset_settings = new QSettings(filename, _settings->format(), const_cast<SettingsWidget*>(this));
+    }
+    return _preset_settings;
+}
+
+
 void SettingsWidget::addPanel(QString panelname, SettingsPanel* panel, QIcon icon)
 {
+    // panels that were never shown are the first to be evicted
+    _recent_panels.append(panel);
     _panel_container->addTab(panel, icon, panelname);
+    applyEvictionBudget();
 }
 
 
 void SettingsWidget::addJsonPanel(QString panelname, QString filename, QIcon icon)
 {
-    QFile json_file(filename);
-    if(!json_file.open(QIODevice::ReadOnly))
+    // parsed files and included fragments are cached
+    bool ok;
+    QJsonArray json = SettingsSchema::load(filename, &ok);
+    if(!ok)
     {
-        qWarning() << "Couldn't open json file " << filename << " - skipping panel creation";
+        qWarning() << "Couldn't load json file " << filename << " - skipping panel creation";
         return;
     }
 
-    QByteArray data = json_file.readAll();
-    json_file.close();
-    QJsonDocument json_doc = QJsonDocument::fromJson(data);
+    addJsonPanel(panelname, json, icon);
+    SettingsPanel* panel = (SettingsPanel*)_panel_container->widget(_panel_container->count() - 1);
 
-    if(!json_doc.isArray())
+    // long descriptions can be kept out of the schema, the file is read on the first tooltip of its settings
+    QString help_file = SettingsHelp::helpFileFor(filename);
+    if(QFileInfo::exists(help_file))
     {
-        qWarning() << "Json file " << filename << " does not contain a json array - skipping panel creation.";
-        return;
+        SettingsHelp::addFile(help_file, panel->settingPaths());
+    }
+    _schema_files.insert(panel, QFileInfo(filename).absoluteFilePath());
+    if(_schema_watcher)
+    {
+        watchSchemaFiles();
     }
-
-    addJsonPanel(panelname, json_doc.array(), icon);
 }
 
 
 void SettingsWidget::addJsonPanel(QString panelname, QJsonArray json, QIcon icon)
 {
-    addPanel(panelname, SettingsPanel::fromJson(json, _settings), icon);
+    SettingsPanel* panel = SettingsPanel::fromJson(json, _settings, nullptr, _progressive, _lite);
+    if(panel->isConstructing())
+    {
+        connect(panel, &SettingsPanel::constructionProgress, this, [this, panel](int done, int total) {
+            emit constructionProgress(panel, done, total);
+        });
+    }
+    addPanel(panelname, panel, icon);
+}
+
+
+QByteArray SettingsWidget::exportSnapshot(SnapshotFormat format) const
+{
+    QVariantHash values;
+    for(int i=0; i<_panel_container->count(); ++i)
+    {
+        SettingsPanel* panel = (SettingsPanel*)_panel_container->widget(i);
+        panel->collectChangedValues(values);
+    }
+
+    if(format == Cbor)
+    {
+        return QCborValue(QCborMap::fromVariantHash(values)).toCbor();
+    }
+    return QJsonDocument(QJsonObject::fromVariantHash(values)).toJson(QJsonDocument::Compact);
+}
+
+
+SettingsWidget::SnapshotReport SettingsWidget::importSnapshot(const QByteArray& data, SnapshotFormat format)
+{
+    SnapshotReport report;
+    QVariantHash snapshot;
+    if(format == Cbor)
+    {
+        QCborParserError error;
+        QCborValue cbor = QCborValue::fromCbor(data, &error);
+        if(error.error != QCborError::NoError or !cbor.isMap())
+        {
+            qWarning() << "Invalid settings snapshot - nothing imported";
+            return report;
+        }
+        snapshot = cbor.toMap().toVariantHash();
+    }
+    else
+    {
+        QJsonParseError error;
+        QJsonDocument json_doc = QJsonDocument::fromJson(data, &error);
+        if(error.error != QJsonParseError::NoError or !json_doc.isObject())
+        {
+            qWarning() << "Invalid settings snapshot - nothing imported";
+            return report;
+        }
+        snapshot = json_doc.object().toVariantHash();
+    }
+
+    QHash<SettingsPanel*, QVariantHash> accepted = assignValues(snapshot, report);
+    for(auto it = accepted.begin(); it != accepted.end(); ++it)
+    {
+        it.key()->writeValues(it.value());
+    }
+    SettingsStore::syncSettings(_settings);
+    publishCache();
+
+    for(int i=0; i<_panel_container->count(); ++i)
+    {
+        SettingsPanel* panel = (SettingsPanel*)_panel_container->widget(i);
+        panel->reloadSettings();
+    }
+    return report;
+}
+
+
+SettingsWidget::SnapshotReport SettingsWidget::applyValues(const QVariantHash& values)
+{
+    SnapshotReport report;
+    QHash<SettingsPanel*, QVariantHash> accepted = assignValues(values, report);
+    for(auto it = accepted.begin(); it != accepted.end(); ++it)
+    {
+        it.key()->applyValues(it.value());
+    }
+    return report;
+}
+
+
+QVariant SettingsWidget::savedValue(const QString& path) const
+{
+    for(int i=0; i<_panel_container->count(); ++i)
+    {
+        SettingsPanel* panel = (SettingsPanel*)_panel_container->widget(i);
+        QVariant value = panel->savedValue(path);
+        if(value.isValid())
+        {
+            return value;
+        }
+    }
+    QString section, key;
+    SettingsStore::splitPath(path, section, key);
+    return SettingsStore::readValue(_settings, section, key, QVariant());
+}
+
+
+QHash<SettingsPanel*, QVariantHash> SettingsWidget::assignValues(const QVariantHash& values, SnapshotReport& report) const
+{
+    QHash<QString, SettingsPanel*> owners;
+    for(int i=0; i<_panel_container->count(); ++i)
+    {
+        SettingsPanel* panel = (SettingsPanel*)_panel_container->widget(i);
+        for(const QString& path: panel->settingPaths())
+        {
+            owners.insert(path, panel);
+        }
+    }
+
+    QHash<SettingsPanel*, QVariantHash> accepted;
+    for(auto it = values.begin(); it != values.end(); ++it)
+    {
+        SettingsPanel* panel = owners.value(it.key(), nullptr);
+        if(!panel)
+        {
+            report.unknown << it.key();
+            continue;
+        }
+        QVariant value = it.value();
+        if(!panel->convertValue(it.key(), value))
+        {
+            report.rejected << it.key();
+            continue;
+        }
+        accepted[panel].insert(it.key(), value);
+        ++report.applied;
+    }
+    return accepted;
 }
 
 
@@ -100,6 +409,119 @@ void SettingsWidget::saveSettings()
         SettingsPanel* panel = (SettingsPanel*)_panel_container->widget(i);
         panel->saveSettings();
     }
+    SettingsStore::syncSettings(_settings);
+    publishCache();
+}
+
+
+void SettingsWidget::publishCache()
+{
+    if(!_cache)
+    {
+        return;
+    }
+    QVariantHash values;
+    for(int i=0; i<_panel_container->count(); ++i)
+    {
+        SettingsPanel* panel = (SettingsPanel*)_panel_container->widget(i);
+        panel->collectValues(values);
+    }
+    _cache->publish(values);
+}
+
+
+void SettingsWidget::panelShown(int index)
+{
+    SettingsPanel* panel = (SettingsPanel*)_panel_container->widget(index);
+    if(!panel)
+    {
+        return;
+    }
+    _recent_panels.removeOne(panel);
+    _recent_panels.prepend(panel);
+    applyEvictionBudget();
+}
+
+
+void SettingsWidget::applyEvictionBudget()
+{
+    if(_eviction_budget <= 0)
+    {
+        return;
+    }
+
+    QVector<qint64> costs;
+    qint64 total = 0;
+    for(SettingsPanel* panel: _recent_panels)
+    {
+        costs << (_budget_unit == Items ? panel->constructedCount() : panel->estimatedWidgetMemory());
+        total += costs.last();
+    }
+    QWidget* current = _panel_container->currentWidget();
+    for(int i=_recent_panels.size()-1; i>=0 and total>_eviction_budget; --i)
+    {
+        if(_recent_panels[i] == current or costs[i] == 0)
+        {
+            continue;
+        }
+        _recent_panels[i]->evictWidgets();
+        total -= costs[i];
+        total += _budget_unit == Items ? _recent_panels[i]->constructedCount()
+                                       : _recent_panels[i]->estimatedWidgetMemory();
+    }
+}
+
+
+void SettingsWidget::watchSchemaFiles()
+{
+    QStringList watched = _schema_watcher->files();
+    QStringList files;
+    for(const QString& filename: _schema_files)
+    {
+        for(const QString& path: SettingsSchema::includedFiles(filename))
+        {
+            if(!watched.contains(path) and !files.contains(path) and QFileInfo::exists(path))
+            {
+                files << path;
+            }
+        }
+    }
+    if(!files.isEmpty())
+    {
+        _schema_watcher->addPaths(files);
+    }
+}
+
+
+void SettingsWidget::reloadSchemas()
+{
+    // a file rewritten within the same second with the same size would look unchanged to the cache
+    SettingsSchema::clearCache();
+    for(auto it = _schema_files.constBegin(); it != _schema_files.constEnd(); ++it)
+    {
+        bool changed = false;
+        for(const QString& path: SettingsSchema::includedFiles(it.value()))
+        {
+            changed = changed or _changed_schema_files.contains(path);
+        }
+        if(!changed)
+        {
+            continue;
+        }
+
+        bool ok;
+        QJsonArray json = SettingsSchema::load(it.value(), &ok);
+        if(!ok)
+        {
+            // probably saved halfway, the next change brings the panel up to date
+            qWarning() << "Couldn't reload json file " << it.value() << " - keeping the panel";
+            continue;
+        }
+        it.key()->updateFromJson(json);
+    }
+    _changed_schema_files.clear();
+    // editors that replace files remove them from the watcher
+    watchSchemaFiles();
 }
 
 
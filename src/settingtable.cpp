@@ -0,0 +1,603 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include "settingtable.h"
+
+namespace
+{
+    SettingTableModel::Column parseColumn(const QJsonObject& obj, const QString& type, const QString& title)
+    {
+        SettingTableModel::Column column;
+        column.title = title;
+        if (type == "bool")
+        {
+            column.type = SettingTableModel::Column::Bool;
+        }
+        else if (type == "numeric")
+        {
+            column.type = SettingTableModel::Column::Numeric;
+        }
+        else
+        {
+            if (!type.isEmpty() and type != "string")
+            {
+                qWarning() << "Unsupported column type " << type << " - using string";
+            }
+            column.type = SettingTableModel::Column::String;
+        }
+        column.minimum = obj.contains("minimum") ? obj.value("minimum").toDouble()
+                                                 : std::numeric_limits<double>::lowest();
+        column.maximum = obj.contains("maximum") ? obj.value("maximum").toDouble()
+                                                 : std::numeric_limits<double>::max();
+        return column;
+    }
+
+    bool isList(const QVariant& value)
+    {
+        return value.type() == QVariant::List or value.type() == QVariant::StringList;
+    }
+}
+
+
+/////////////////////////////
+// SettingTableModel
+/////////////////////////////
+
+SettingTableModel::SettingTableModel(QVector<Column> columns, QObject* parent)
+    : QAbstractTableModel(parent), _columns(columns), _dirty_from(std::numeric_limits<int>::max()), _stored_rows(-1)
+{
+}
+
+
+int SettingTableModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : _rows.size();
+}
+
+
+int SettingTableModel::columnCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : _columns.size();
+}
+
+
+QVariant SettingTableModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid())
+    {
+        return QVariant();
+    }
+
+    const QVariant& value = _rows[index.row()][index.column()];
+    if (_columns[index.column()].type == Column::Bool)
+    {
+        if (role == Qt::CheckStateRole)
+        {
+            return value.toBool() ? Qt::Checked : Qt::Unchecked;
+        }
+        return QVariant();
+    }
+    if (role == Qt::DisplayRole or role == Qt::EditRole)
+    {
+        return value;
+    }
+    return QVariant();
+}
+
+
+bool SettingTableModel::setData(const QModelIndex& index, const QVariant& value, int role)
+{
+    if (!index.isValid())
+    {
+        return false;
+    }
+
+    const Column& column = _columns[index.column()];
+    QVariant new_value = value;
+    if (column.type == Column::Bool)
+    {
+        if (role != Qt::CheckStateRole)
+        {
+            return false;
+        }
+        new_value = (value.toInt() == Qt::Checked);
+    }
+    else if (role != Qt::EditRole)
+    {
+        return false;
+    }
+    if (!convertCell(column, new_value))
+    {
+        return false;
+    }
+
+    QVariant& cell = _rows[index.row()][index.column()];
+    if (cell == new_value)
+    {
+        return true;
+    }
+    cell = new_value;
+    if (index.row() < _dirty_from)
+    {
+        _dirty_rows.insert(index.row());
+    }
+    emit dataChanged(index, index);
+    return true;
+}
+
+
+Qt::ItemFlags SettingTableModel::flags(const QModelIndex& index) const
+{
+    if (!index.isValid())
+    {
+        return Qt::NoItemFlags;
+    }
+    if (_columns[index.column()].type == Column::Bool)
+    {
+        return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsUserCheckable;
+    }
+    return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsEditable;
+}
+
+
+QVariant SettingTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole)
+    {
+        return QVariant();
+    }
+    if (orientation == Qt::Horizontal)
+    {
+        return section < _columns.size() ? _columns[section].title : QVariant();
+    }
+    return section + 1;
+}
+
+
+bool SettingTableModel::insertRows(int row, int count, const QModelIndex& parent)
+{
+    if (parent.isValid() or row < 0 or row > _rows.size() or count <= 0)
+    {
+        return false;
+    }
+    beginInsertRows(parent, row, row + count - 1);
+    _rows.insert(row, count, defaultRow());
+    markDirtyFrom(row);
+    endInsertRows();
+    return true;
+}
+
+
+bool SettingTableModel::removeRows(int row, int count, const QModelIndex& parent)
+{
+    if (parent.isValid() or row < 0 or count <= 0 or row + count > _rows.size())
+    {
+        return false;
+    }
+    beginRemoveRows(parent, row, row + count - 1);
+    _rows.remove(row, count);
+    markDirtyFrom(row);
+    endRemoveRows();
+    return true;
+}
+
+
+void SettingTableModel::setRows(QVector<QVariantList> rows, int stored_rows, bool dirty)
+{
+    beginResetModel();
+    _rows = rows;
+    _stored_rows = stored_rows;
+    _dirty_rows.clear();
+    _dirty_from = dirty ? 0 : std::numeric_limits<int>::max();
+    endResetModel();
+}
+
+
+const QVector<QVariantList>& SettingTableModel::rows() const
+{
+    return _rows;
+}
+
+
+QVector<int> SettingTableModel::dirtyRows() const
+{
+    QVector<int> rows;
+    for (int row: _dirty_rows)
+    {
+        if (row < _dirty_from)
+        {
+            rows << row;
+        }
+    }
+    std::sort(rows.begin(), rows.end());
+    for (int row=_dirty_from; row<_rows.size(); ++row)
+    {
+        rows << row;
+    }
+    return rows;
+}
+
+
+int SettingTableModel::storedRowCount() const
+{
+    return _stored_rows;
+}
+
+
+void SettingTableModel::markClean()
+{
+    _stored_rows = _rows.size();
+    _dirty_rows.clear();
+    _dirty_from = std::numeric_limits<int>::max();
+}
+
+
+bool SettingTableModel::convertCell(const Column& column, QVariant& value)
+{
+    switch(column.type)
+    {
+        case Column::Bool:
+            return SettingBool::convertValue(QJsonObject(), value);
+        case Column::Numeric:
+        {
+            bool ok = false;
+            double number = value.toDouble(&ok);
+            if (!ok or number < column.minimum or number > column.maximum)
+            {
+                return false;
+            }
+            value = number;
+            return true;
+        }
+        case Column::String:
+            return SettingString::convertValue(QJsonObject(), value);
+    }
+    return false;
+}
+
+
+void SettingTableModel::markDirtyFrom(int row)
+{
+    // rows behind an inserted or removed row move, so they all have to be written again
+    _dirty_from = qMin(_dirty_from, row);
+}
+
+
+QVariantList SettingTableModel::defaultRow() const
+{
+    QVariantList row;
+    row.reserve(_columns.size());
+    for (const Column& column: _columns)
+    {
+        switch(column.type)
+        {
+            case Column::Bool:
+                row << false;
+                break;
+            case Column::Numeric:
+                row << qBound(column.minimum, 0.0, column.maximum);
+                break;
+            case Column::String:
+                row << QString();
+                break;
+        }
+    }
+    return row;
+}
+
+
+/////////////////////////////
+// SettingTable
+/////////////////////////////
+
+SettingTable::SettingTable(QSettings* settings, QString title, QString section, QString key,
+                           QVector<SettingTableModel::Column> columns, bool single_column,
+                           QVariantList default_value, QString desc, QWidget* parent)
+    : SettingItem(settings, section, key, desc, parent), _single_column(single_column),
+      _default_value(default_value), _columns(columns)
+{
+    auto layout = new QVBoxLayout(this);
+    QLabel* label = new QLabel(title, this);
+    _model = new SettingTableModel(columns, this);
+    _view = new QTableView(this);
+    _view->setModel(_model);
+    _view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    // fixed row heights keep scrolling through large lists cheap
+    _view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    _view->horizontalHeader()->setStretchLastSection(true);
+
+    auto buttons = new QHBoxLayout();
+    auto add_btn = new QPushButton(QIcon::fromTheme("list-add"), "", this);
+    auto remove_btn = new QPushButton(QIcon::fromTheme("list-remove"), "", this);
+    buttons->addStretch();
+    buttons->addWidget(add_btn);
+    buttons->addWidget(remove_btn);
+
+    layout->addWidget(label);
+    layout->addWidget(_view);
+    layout->addLayout(buttons);
+    setLayout(layout);
+
+    connect(add_btn, &QPushButton::clicked, this, &SettingTable::addRow);
+    connect(remove_btn, &QPushButton::clicked, this, &SettingTable::removeSelectedRows);
+    connect(_model, &QAbstractItemModel::dataChanged, this, &SettingItem::valueChanged);
+    connect(_model, &QAbstractItemModel::rowsInserted, this, &SettingItem::valueChanged);
+    connect(_model, &QAbstractItemModel::rowsRemoved, this, &SettingItem::valueChanged);
+    connect(_model, &QAbstractItemModel::modelReset, this, &SettingItem::valueChanged);
+
+    // load the settings
+    loadSetting();
+}
+
+
+SettingItem* SettingTable::fromJsonObject(QJsonObject obj, QSettings* settings, QWidget* parent)
+{
+    bool single_column = obj["type"].toString() == "list";
+    if (!obj.contains("title") or !obj.contains("section") or !obj.contains("key") or
+        (!single_column and !obj.contains("columns")))
+    {
+        qWarning() << "SettingTable item created from json is missing (a) mandatory field(s)";
+        return nullptr;
+    }
+    // parse the json object
+    QString title = obj["title"].toString();
+    QString section = obj["section"].toString();
+    QString key = obj["key"].toString();
+    QString desc = obj["desc"].toString();
+    QVector<SettingTableModel::Column> columns = parseColumns(obj);
+    if (columns.isEmpty())
+    {
+        qWarning() << "SettingTable " << title << " has no columns";
+        return nullptr;
+    }
+
+    QVariant default_value = QVariantList();
+    if (obj.contains("default"))
+    {
+        default_value = obj["default"].toVariant();
+        if (!convertRows(columns, single_column, default_value))
+        {
+            qWarning() << "Invalid default value for SettingTable " << title << " - using an empty list";
+            default_value = QVariantList();
+        }
+    }
+
+    return new SettingTable(settings, title, section, key, columns, single_column, default_value.toList(),
+                            desc, parent);
+}
+
+
+bool SettingTable::convertValue(const QJsonObject& obj, QVariant& value)
+{
+    QVector<SettingTableModel::Column> columns = parseColumns(obj);
+    if (columns.isEmpty())
+    {
+        return false;
+    }
+    return convertRows(columns, obj.value("type").toString() == "list", value);
+}
+
+
+QVariant SettingTable::readRows(QSettings* settings, const QString& section, const QString& key)
+{
+    QString base = SettingsStore::path(section, key);
+    QVariant size = SettingsStore::readValue(settings, base, "size", QVariant());
+    if (!size.isValid())
+    {
+        return QVariant();
+    }
+
+    int count = size.toInt();
+    QVariantList rows;
+    rows.reserve(count);
+    for (int row=1; row<=count; ++row)
+    {
+        rows << SettingsStore::readValue(settings, base, QString::number(row), QVariant());
+    }
+    return rows;
+}
+
+
+void SettingTable::writeRows(QSettings* settings, const QString& section, const QString& key, const QVariant& value)
+{
+    QString base = SettingsStore::path(section, key);
+    int stored_count = SettingsStore::readValue(settings, base, "size", 0).toInt();
+    QVariantList rows = value.toList();
+    for (int row=0; row<rows.size(); ++row)
+    {
+        SettingsStore::writeValue(settings, base, QString::number(row + 1), rows[row]);
+    }
+    for (int row=rows.size(); row<stored_count; ++row)
+    {
+        SettingsStore::removeValue(settings, base, QString::number(row + 1));
+    }
+    SettingsStore::writeValue(settings, base, "size", rows.size());
+}
+
+
+void SettingTable::restoreDefault()
+{
+    _model->setRows(toRows(_default_value), _model->storedRowCount(), true);
+}
+
+
+void SettingTable::loadSetting()
+{
+    QVariant stored = readRows(_settings, _section, _key);
+    int stored_rows = stored.isValid() ? stored.toList().size() : -1;
+    if (stored.isValid() and convertRows(_columns, _single_column, stored))
+    {
+        _model->setRows(toRows(stored.toList()), stored_rows, false);
+        return;
+    }
+
+    if (stored.isValid())
+    {
+        qWarning() << "Stored value of " << _section << "/" << _key << " does not match the columns - using the default";
+    }
+    _model->setRows(toRows(_default_value), stored_rows, true);
+}
+
+
+void SettingTable::saveSetting()
+{
+    QString base = SettingsStore::path(_section, _key);
+    const QVector<QVariantList>& rows = _model->rows();
+    for (int row: _model->dirtyRows())
+    {
+        QVariant stored_row = _single_column ? rows[row].value(0) : QVariant(rows[row]);
+        SettingsStore::writeValue(_settings, base, QString::number(row + 1), stored_row);
+    }
+    for (int row=rows.size(); row<_model->storedRowCount(); ++row)
+    {
+        SettingsStore::removeValue(_settings, base, QString::number(row + 1));
+    }
+    if (rows.size() != _model->storedRowCount())
+    {
+        SettingsStore::writeValue(_settings, base, "size", rows.size());
+    }
+    _model->markClean();
+}
+
+
+QVariant SettingTable::value() const
+{
+    const QVector<QVariantList>& rows = _model->rows();
+    QVariantList value;
+    value.reserve(rows.size());
+    for (const QVariantList& row: rows)
+    {
+        value << (_single_column ? row.value(0) : QVariant(row));
+    }
+    return value;
+}
+
+
+QVariant SettingTable::defaultValue() const
+{
+    return _default_value;
+}
+
+
+void SettingTable::setValue(const QVariant& value)
+{
+    _model->setRows(toRows(value.toList()), _model->storedRowCount(), true);
+}
+
+
+QVector<SettingTableModel::Column> SettingTable::parseColumns(const QJsonObject& obj)
+{
+    QVector<SettingTableModel::Column> columns;
+    if (obj.value("type").toString() == "list")
+    {
+        columns << parseColumn(obj, obj.value("item_type").toString(), obj.value("item_title").toString("Value"));
+        return columns;
+    }
+
+    for (auto column_ref: obj.value("columns").toArray())
+    {
+        QJsonObject column = column_ref.toObject();
+        columns << parseColumn(column, column.value("type").toString(), column.value("title").toString());
+    }
+    return columns;
+}
+
+
+bool SettingTable::convertRows(const QVector<SettingTableModel::Column>& columns, bool single_column, QVariant& value)
+{
+    if (!isList(value))
+    {
+        return false;
+    }
+
+    QVariantList rows = value.toList();
+    for (QVariant& row: rows)
+    {
+        if (single_column)
+        {
+            if (!SettingTableModel::convertCell(columns[0], row))
+            {
+                return false;
+            }
+            continue;
+        }
+
+        if (!isList(row))
+        {
+            return false;
+        }
+        QVariantList cells = row.toList();
+        if (cells.size() != columns.size())
+        {
+            return false;
+        }
+        for (int i=0; i<cells.size(); ++i)
+        {
+            if (!SettingTableModel::convertCell(columns[i], cells[i]))
+            {
+                return false;
+            }
+        }
+        row = cells;
+    }
+    value = rows;
+    return true;
+}
+
+
+QVector<QVariantList> SettingTable::toRows(const QVariantList& value) const
+{
+    QVector<QVariantList> rows;
+    rows.reserve(value.size());
+    for (const QVariant& row: value)
+    {
+        rows << (_single_column ? QVariantList{row} : row.toList());
+    }
+    return rows;
+}
+
+
+void SettingTable::addRow()
+{
+    QModelIndex current = _view->currentIndex();
+    int row = current.isValid() ? current.row() + 1 : _model->rowCount();
+    _model->insertRows(row, 1);
+    _view->setCurrentIndex(_model->index(row, 0));
+    _view->scrollTo(_model->index(row, 0));
+}
+
+
+void SettingTable::removeSelectedRows()
+{
+    QList<int> rows;
+    for (const QModelIndex& index: _view->selectionModel()->selectedRows())
+    {
+        rows << index.row();
+    }
+    // remove from the bottom so the remaining indices stay valid
+    std::sort(rows.begin(), rows.end(), std::greater<int>());
+    for (int row: rows)
+    {
+        _model->removeRows(row, 1);
+    }
+}
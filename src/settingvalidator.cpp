@@ -0,0 +1,144 @@
+/**
+ * SettingsWidget-qt5
+ *
+ * Copyright (C) 2016 Sebastian Schmidt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <limits>
+#include <QDebug>
+#include <QHash>
+#include "settingvalidator.h"
+
+namespace
+{
+    QHash<QString, SettingValidator::AsyncValidator> _async_validators;
+
+    /**
+     * @brief Compiled expressions by pattern, QRegularExpression copies share the compiled pattern
+     */
+    QHash<QString, QRegularExpression> _patterns;
+
+    QRegularExpression compiledPattern(const QString& pattern)
+    {
+        auto it = _patterns.find(pattern);
+        if (it == _patterns.end())
+        {
+            QRegularExpression regex(QRegularExpression::anchoredPattern(pattern));
+            if (!regex.isValid())
+            {
+                qWarning() << "Invalid pattern " << pattern << ": " << regex.errorString() << " - ignoring it";
+                regex = QRegularExpression();
+            }
+            regex.optimize();
+            it = _patterns.insert(pattern, regex);
+        }
+        return it.value();
+    }
+}
+
+
+SettingValidator::SettingValidator()
+    : _min_length(-1), _max_length(-1), _numeric(false),
+      _minimum(std::numeric_limits<double>::lowest()), _maximum(std::numeric_limits<double>::max())
+{
+}
+
+
+SettingValidator SettingValidator::fromJsonObject(const QJsonObject& obj)
+{
+    SettingValidator validator;
+    if (obj.contains("pattern"))
+    {
+        validator._pattern = compiledPattern(obj.value("pattern").toString());
+    }
+    validator._min_length = obj.value("min_length").toInt(-1);
+    validator._max_length = obj.value("max_length").toInt(-1);
+    if (obj.contains("minimum"))
+    {
+        validator._numeric = true;
+        validator._minimum = obj.value("minimum").toDouble();
+    }
+    if (obj.contains("maximum"))
+    {
+        validator._numeric = true;
+        validator._maximum = obj.value("maximum").toDouble();
+    }
+    if (obj.contains("validator"))
+    {
+        QString name = obj.value("validator").toString();
+        validator._async_validator = _async_validators.value(name);
+        if (!validator._async_validator)
+        {
+            qWarning() << name << " is no registered validator - ignoring it";
+        }
+    }
+    return validator;
+}
+
+
+void SettingValidator::registerAsyncValidator(QString name, AsyncValidator validator)
+{
+    if (_async_validators.contains(name))
+    {
+        qWarning() << name << " allready exists - not adding the new validator";
+        return;
+    }
+    _async_validators[name] = validator;
+}
+
+
+bool SettingValidator::isNull() const
+{
+    return _pattern.pattern().isEmpty() and _min_length < 0 and _max_length < 0 and !_numeric and !_async_validator;
+}
+
+
+QString SettingValidator::validate(const QString& text) const
+{
+    if (_min_length >= 0 and text.size() < _min_length)
+    {
+        return QString("At least %1 characters are required").arg(_min_length);
+    }
+    if (_max_length >= 0 and text.size() > _max_length)
+    {
+        return QString("At most %1 characters are allowed").arg(_max_length);
+    }
+    if (_numeric)
+    {
+        bool ok = false;
+        double number = text.toDouble(&ok);
+        if (!ok)
+        {
+            return "Not a number";
+        }
+        if (number < _minimum or number > _maximum)
+        {
+            return QString("Must be between %1 and %2").arg(_minimum).arg(_maximum);
+        }
+    }
+    if (!_pattern.pattern().isEmpty() and !_pattern.match(text).hasMatch())
+    {
+        return "Does not match the expected format";
+    }
+    return QString();
+}
+
+
+SettingValidator::AsyncValidator SettingValidator::asyncValidator() const
+{
+    return _async_validator;
+}